@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef RPI_ACPI_THERMAL_CTL_H
+#define RPI_ACPI_THERMAL_CTL_H
+
+/*
+ * RPIT0001 control loop arithmetic: the temperature filter and trip bands,
+ * the adaptive poll decision, the set-point PID and the load feed-forward.
+ * Everything here depends only on its arguments, with time passed in as
+ * milliseconds, so that rpi-acpi-thermal and the replay harness in
+ * driver/tests run the same code. Userspace builds provide the kernel
+ * types, div_s64(), min()/max()/clamp_t() and enum thermal_trend before
+ * including this file.
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
+#include <linux/math.h>
+#include <linux/thermal.h>
+#endif
+
+#define RPI_THERMAL_PID_SCALE	1000000LL	/* micro-duty per duty step */
+
+/*
+ * Exponential moving average with time constant tau_ms (0 disables it),
+ * followed by the trip band the zone is in. A drop below a trip's
+ * hysteresis release point is held for dwell_ms after entering the band.
+ */
+struct rpi_thermal_filter {
+	u32 tau_ms;
+	u32 dwell_ms;
+	bool valid;
+	int temp;
+	s64 time_ms;
+	int band;		/* number of trips the zone is in */
+	s64 band_since_ms;
+	u64 band_changes;
+	u64 suppressed;
+};
+
+struct rpi_thermal_poll {
+	u32 min_ms;
+	u32 max_ms;
+	s32 trip_margin;	/* mC */
+	s32 rise_rate;		/* mC/s */
+	unsigned int interval_ms;
+};
+
+/* Gains in milli-duty per C, per C second and per C per second */
+struct rpi_thermal_pid {
+	s32 setpoint;
+	s32 kp;
+	s32 ki;
+	s32 kd;
+	s64 integral;
+	int last_error;
+	bool primed;
+};
+
+static inline int rpi_thermal_band(const s32 *trip_temps, const s32 *trip_hyst,
+                                   int trip_count, int band, int temp)
+{
+	while (band < trip_count && temp >= trip_temps[band])
+		band++;
+	while (band > 0 && temp < trip_temps[band - 1] - trip_hyst[band - 1])
+		band--;
+
+	return band;
+}
+
+/* Returns the temperature to report for raw; f->band follows it */
+static inline int rpi_thermal_filter(struct rpi_thermal_filter *f,
+                                     const s32 *trip_temps, const s32 *trip_hyst,
+                                     int trip_count, int raw, s64 now_ms)
+{
+	int temp, band;
+
+	if (!f->valid || !f->tau_ms) {
+		f->temp = raw;
+		f->valid = true;
+	} else {
+		s64 dt = now_ms - f->time_ms;
+
+		f->temp += div_s64((s64)(raw - f->temp) * dt, f->tau_ms + dt);
+	}
+	f->time_ms = now_ms;
+	temp = f->temp;
+
+	band = rpi_thermal_band(trip_temps, trip_hyst, trip_count, f->band, temp);
+	if (band < f->band && f->dwell_ms && now_ms - f->band_since_ms < f->dwell_ms) {
+		/* Report the release point so the trip stays active */
+		temp = trip_temps[f->band - 1] - trip_hyst[f->band - 1];
+		f->suppressed++;
+	} else if (band != f->band) {
+		f->band = band;
+		f->band_since_ms = now_ms;
+		f->band_changes++;
+	}
+
+	return temp;
+}
+
+/* The trend .get_trend reports for one trip */
+static inline enum thermal_trend rpi_thermal_trip_trend(int temp, s32 trip_temp,
+                                                        s32 trip_hyst)
+{
+	if (temp < trip_temp - trip_hyst)
+		return THERMAL_TREND_DROPPING;
+	if (temp >= trip_temp)
+		return THERMAL_TREND_RAISING;
+	return THERMAL_TREND_STABLE;
+}
+
+/*
+ * Poll fast while within trip_margin of a trip or of its release point, or
+ * while heating faster than rise_rate.
+ */
+static inline bool rpi_thermal_poll_fast(const struct rpi_thermal_poll *p,
+                                         const s32 *trip_temps, const s32 *trip_hyst,
+                                         int trip_count, int temp, int last_temp,
+                                         s64 elapsed_ms)
+{
+	int i;
+
+	if (elapsed_ms > 0 &&
+	    div_s64((s64)(temp - last_temp) * 1000, elapsed_ms) >= p->rise_rate)
+		return true;
+
+	for (i = 0; i < trip_count; i++) {
+		int trip = trip_temps[i];
+		int release = trip - trip_hyst[i];
+
+		if (abs(temp - trip) <= p->trip_margin ||
+		    abs(temp - release) <= p->trip_margin)
+			return true;
+	}
+
+	return false;
+}
+
+/* Resets to min_ms when fast, otherwise doubles up to max_ms; cap_ms 0 is none */
+static inline unsigned int rpi_thermal_poll_next(struct rpi_thermal_poll *p, bool fast,
+                                                 u32 cap_ms)
+{
+	if (fast)
+		p->interval_ms = p->min_ms;
+	else
+		p->interval_ms = min(p->interval_ms * 2, p->max_ms);
+
+	if (cap_ms)
+		p->interval_ms = min(p->interval_ms, cap_ms);
+
+	return p->interval_ms;
+}
+
+/* One controller step dt ms after the last; returns the duty, 0..max_duty */
+static inline unsigned int rpi_thermal_pid_step(struct rpi_thermal_pid *pid, int temp,
+                                                s64 dt, unsigned int max_duty)
+{
+	s64 error, p, d = 0, out, max_out = max_duty * RPI_THERMAL_PID_SCALE;
+
+	/* Positive error means the zone is hotter than the target */
+	error = temp - pid->setpoint;
+	p = (s64)pid->kp * error;
+
+	if (pid->primed && dt > 0)
+		d = div_s64((s64)pid->kd * (error - pid->last_error) * 1000, dt);
+
+	out = p + pid->integral + d;
+
+	/*
+	 * Anti-windup: only integrate while the output is not saturated in
+	 * the direction the error pushes it, and keep the integral within the
+	 * actuator range.
+	 */
+	if (pid->primed && dt > 0 &&
+	    !(out >= max_out && error > 0) && !(out <= 0 && error < 0)) {
+		pid->integral += div_s64((s64)pid->ki * error * dt, 1000);
+		pid->integral = clamp_t(s64, pid->integral, 0, max_out);
+		out = p + pid->integral + d;
+	}
+
+	pid->last_error = error;
+	pid->primed = true;
+
+	return div_s64(clamp_t(s64, out, 0, max_out), RPI_THERMAL_PID_SCALE);
+}
+
+/* Duty floor for a CPU load in percent, linear from threshold up to gain */
+static inline unsigned int rpi_thermal_ff_duty(u32 gain, u32 threshold, unsigned int load,
+                                               unsigned int max_duty)
+{
+	if (load <= threshold || threshold >= 100)
+		return 0;
+
+	return min(max_duty, gain * (load - threshold) / (100 - threshold));
+}
+
+#endif // RPI_ACPI_THERMAL_CTL_H
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * rpi-acpi-thermal-trace.h - Tracepoints for RPIT0001 temperature reads
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rpi
+
+#if !defined(_RPI_ACPI_THERMAL_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _RPI_ACPI_THERMAL_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * raw is the shared sensor sample, temp what the zone sees after filtering;
+ * both are 0 when ret reports a failed read
+ */
+TRACE_EVENT(rpi_thermal_get_temp,
+	TP_PROTO(int zone, int raw, int temp, int ret),
+	TP_ARGS(zone, raw, temp, ret),
+
+	TP_STRUCT__entry(
+		__field(int, zone)
+		__field(int, raw)
+		__field(int, temp)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__entry->zone = zone;
+		__entry->raw = raw;
+		__entry->temp = temp;
+		__entry->ret = ret;
+	),
+
+	TP_printk("zone=%d raw=%d temp=%d ret=%d",
+	          __entry->zone, __entry->raw, __entry->temp, __entry->ret)
+);
+
+#endif /* _RPI_ACPI_THERMAL_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rpi-acpi-thermal-trace
+#include <trace/define_trace.h>
@@ -6,12 +6,146 @@
 #include <linux/platform_device.h>
 #include <linux/property.h>
 #include <linux/err.h>
+#include <linux/io.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/sysfs.h>
+#include <linux/mutex.h>
+#include <linux/tick.h>
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/units.h>
+#include <linux/miscdevice.h>
+#include <linux/kref.h>
+#include <linux/hwmon.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
 #include <acpi/acpi_bus.h>
+#include "rpi-mailbox.h"
 #include "rpi-pwm-fan.h"
+#include "rpi-acpi-thermal.h"
+#include "rpi-acpi-thermal-ctl.h"
+
+#define CREATE_TRACE_POINTS
+#include "rpi-acpi-thermal-trace.h"
 
 #define DRIVER_NAME "rpi_acpi_thermal"
 #define RPI_HID     "RPIT0001"
 #define MAX_TRIPS   8
+#define MAX_COOLING_DEVS 4
+
+/* Processor references in "cooling-device" bind the cpufreq cooling device */
+#define RPI_CPU_HID        "ACPI0007"
+#define RPI_CPU_OBJECT_HID "ACPI_CPU"
+
+/*
+ * BCM2711 AVS temperature status register, mapped through _CRS. The
+ * conversion defaults match the constants used by _TMP and can be
+ * overridden with the "sensor-offset" and "sensor-slope" _DSD properties.
+ */
+#define RPI_SENSOR_VALID_MSK	(BIT(16) | BIT(10))
+#define RPI_SENSOR_DATA_MSK	GENMASK(9, 0)
+#define RPI_SENSOR_OFFSET	410040
+#define RPI_SENSOR_SLOPE	487
+
+/*
+ * Adaptive polling defaults. The zone is sampled every polling-min-ms while
+ * the temperature is within polling-trip-margin of a trip (or of its
+ * hysteresis release point) or rising faster than polling-rise-rate, and
+ * the interval doubles up to polling-max-ms otherwise.
+ */
+#define RPI_POLL_MIN_MS		50
+#define RPI_POLL_MAX_MS		4000
+#define RPI_POLL_TRIP_MARGIN	2000	/* mC */
+#define RPI_POLL_RISE_RATE	500	/* mC/s */
+
+/*
+ * Sample cache. The thermal zone, the hwmon device and any other reader
+ * share one sensor sample, which is re-read only once it is older than
+ * sample-max-age-ms (0 reads the sensor every time).
+ */
+#define RPI_SAMPLE_MAX_AGE_MS	25
+
+/*
+ * Temperature filter. Raw samples go through an exponential moving average
+ * with time constant filter-time-constant-ms (0 disables it). A drop below a
+ * trip's hysteresis release point is then held for state-dwell-ms after the
+ * zone entered that band, so the fan is not stepped down right after being
+ * stepped up.
+ */
+#define RPI_FILTER_TAU_MS	0
+#define RPI_STATE_DWELL_MS	0
+
+/*
+ * Set-point mode ("control-mode" = "setpoint"). Instead of binding the fan
+ * to the active trips, a PID controller drives its duty continuously to
+ * hold the zone at setpoint-temp. Gains are in milli-duty per degree C
+ * (kp), per degree C second (ki) and per degree C per second (kd); the
+ * controller runs at least every pid-period-ms.
+ */
+#define RPI_PID_SETPOINT	70000
+#define RPI_PID_KP		40000
+#define RPI_PID_KI		2000
+#define RPI_PID_KD		0
+#define RPI_PID_PERIOD_MS	1000
+
+/*
+ * CPU load feed-forward. Each sample measures CPU utilization from the
+ * idle time accounting; above feedforward-threshold percent it raises a
+ * fan duty floor linearly up to feedforward-gain at full load. Userspace
+ * can write an expected load to load_hint, which holds for
+ * feedforward-hint-ms. A gain of 0 disables the feature.
+ */
+#define RPI_FF_GAIN		0
+#define RPI_FF_THRESHOLD	25	/* percent */
+#define RPI_FF_HINT_MS		30000
+
+/*
+ * Userspace notification. The filtered temperature is exposed as the
+ * "temp" attribute, and pollers of it are woken (plus an ACPI netlink
+ * event sent) when it crosses one of "notify-bands" (the active trips by
+ * default) or moves by more than notify-delta since the last event.
+ */
+#define RPI_NOTIFY_DELTA	1000	/* mC, 0 disables */
+#define RPI_ACPI_THERMAL_CLASS	"thermal_zone"
+#define RPI_ACPI_NOTIFY_TEMP	0x80
+
+/* History ring, see rpi-acpi-thermal.h for the layout */
+#define RPI_HIST_ENTRIES	4096
+
+/*
+ * Trip residency, accounted only when the filtered band changes. Excursion
+ * lengths go into power-of-two buckets: < 1 s, < 2 s, ... and a last
+ * bucket for anything longer.
+ */
+#define RPI_RES_BUCKETS		12
+
+/*
+ * Telemetry page with a reference per open file besides the driver's own,
+ * so an fd held across remove keeps mapping a valid, frozen page.
+ */
+struct rpi_acpi_telemetry_buf {
+	struct kref ref;
+	struct rpi_thermal_telemetry *page;
+};
+
+/*
+ * One entry per "cooling-device" reference. The state ranges and weights
+ * come from "cooling-min-states", "cooling-max-states" and the optional
+ * "cooling-weights", laid out as trip_count rows of cdev_count columns.
+ * A weight of 0 leaves the device unbound from that trip and a state of
+ * 0xFFFFFFFF is THERMAL_NO_LIMIT.
+ */
+struct rpi_acpi_cdev {
+	struct acpi_device *adev;
+	bool cpu;
+	s32 min_states[MAX_TRIPS];
+	s32 max_states[MAX_TRIPS];
+	u32 weights[MAX_TRIPS];
+	bool bound[MAX_TRIPS];
+};
 
 static const guid_t dsd_guid = GUID_INIT(0xdaffd814, 0x6eba, 0x4d8c,
                                          0x8a, 0x91, 0xbc, 0x9b, 0xbf, 0x4a, 0xa3, 0x01);
@@ -20,12 +154,82 @@ struct rpi_acpi_thermal {
 	struct thermal_zone_device *tzd;
 	struct acpi_device *adev;
 	struct acpi_device *cdev_adev;
+	/* The fan's cooling device while bound to the zone, under fan_lock */
+	struct mutex fan_lock;
+	struct thermal_cooling_device *fan_cdev;
 	int trip_count;
 	s32 trip_temps[MAX_TRIPS];
 	s32 trip_hyst[MAX_TRIPS];
-	s32 min_states[MAX_TRIPS];
-	s32 max_states[MAX_TRIPS];
+	struct rpi_acpi_cdev cdevs[MAX_COOLING_DEVS];
+	int cdev_count;
 	struct thermal_trip trips[MAX_TRIPS];
+	void __iomem *sensor;
+	s32 sensor_offset;
+	s32 sensor_slope;
+
+	struct mutex sample_lock;
+	u32 sample_max_age_ms;
+	bool sample_valid;
+	int sample_temp;
+	ktime_t sample_time;
+	u64 sample_reads;
+	u64 sample_hits;
+
+	struct hrtimer poll_timer;
+	struct work_struct poll_work;
+	bool polling;
+	struct rpi_thermal_poll poll;
+	int poll_last_temp;
+	ktime_t poll_last_time;
+	u64 poll_samples;
+	u64 poll_fast_samples;
+
+	/* Filter state, serialized by the zone lock held around .get_temp */
+	struct rpi_thermal_filter filter;
+
+	/* Trip residency, protected by res_lock */
+	spinlock_t res_lock;
+	ktime_t res_entered[MAX_TRIPS];
+	u64 res_total_ms[MAX_TRIPS];
+	u64 res_crossings[MAX_TRIPS];
+	u64 res_hist[MAX_TRIPS][RPI_RES_BUCKETS];
+
+	/* Set-point controller, protected by pid_lock */
+	struct mutex pid_lock;
+	bool setpoint_mode;
+	struct rpi_thermal_pid pid;
+	u32 pid_period_ms;
+	unsigned int pid_duty;
+
+	/* Load feed-forward, updated from the poll work */
+	u32 ff_gain;
+	u32 ff_threshold;
+	u32 ff_hint_ms;
+	u64 ff_last_wall;
+	u64 ff_last_idle;
+	unsigned int ff_util;
+	unsigned int ff_hint;
+	unsigned long ff_hint_expires;
+	unsigned int ff_duty;
+
+	struct device *dev;
+	s32 notify_bands[MAX_TRIPS];
+	int notify_band_count;
+	u32 notify_delta;
+	int notify_band;
+	int notify_temp;
+	u64 notify_events;
+
+	/* History ring, written only from the poll work */
+	struct rpi_thermal_hist_header *hist;
+	struct rpi_thermal_hist_entry *hist_entries;
+	size_t hist_size;
+	struct dentry *debugfs;
+
+	/* Telemetry page, written only from the poll work */
+	struct rpi_acpi_telemetry_buf *telemetry_buf;
+	struct rpi_thermal_telemetry *telemetry;
+	struct miscdevice misc;
 };
 
 static inline int check_array_length(struct device *dev, const char *prop, int expected)
@@ -42,14 +246,24 @@ static inline int check_array_length(struct device *dev, const char *prop, int e
 	return 0;
 }
 
-static int rpi_acpi_get_temp(struct thermal_zone_device *tz, int *temp)
+static int rpi_acpi_read_sensor(struct rpi_acpi_thermal *data, int *temp)
 {
-	struct rpi_acpi_thermal *data = tz->devdata;
-	acpi_handle handle = data->adev->handle;
 	unsigned long long val;
 	acpi_status status;
 
-	status = acpi_evaluate_integer(handle, "_TMP", NULL, &val);
+	if (data->sensor) {
+		u32 raw = readl(data->sensor);
+
+		if (!(raw & RPI_SENSOR_VALID_MSK))
+			return -EIO;
+
+		*temp = data->sensor_offset -
+			(int)(raw & RPI_SENSOR_DATA_MSK) * data->sensor_slope;
+		return 0;
+	}
+
+	/* No native sensor mapping: fall back to the AML method */
+	status = acpi_evaluate_integer(data->adev->handle, "_TMP", NULL, &val);
 	if (ACPI_FAILURE(status))
 		return -EIO;
 
@@ -58,11 +272,113 @@ static int rpi_acpi_get_temp(struct thermal_zone_device *tz, int *temp)
 	return 0;
 }
 
+static int rpi_acpi_sample(struct rpi_acpi_thermal *data, int *temp)
+{
+	ktime_t now;
+	int ret = 0;
+
+	mutex_lock(&data->sample_lock);
+
+	now = ktime_get();
+	if (data->sample_valid &&
+	    ktime_ms_delta(now, data->sample_time) < data->sample_max_age_ms) {
+		data->sample_hits++;
+	} else {
+		ret = rpi_acpi_read_sensor(data, &data->sample_temp);
+		data->sample_valid = !ret;
+		data->sample_time = now;
+		data->sample_reads++;
+		rpi_mbox_count(RPI_MBOX_EV_TEMP_SAMPLES, 1);
+	}
+	*temp = data->sample_temp;
+
+	mutex_unlock(&data->sample_lock);
+
+	return ret;
+}
+
+static void rpi_acpi_residency_update(struct rpi_acpi_thermal *data, int old_band,
+                                      int new_band, ktime_t now)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&data->res_lock, flags);
+
+	/* Entered trips old_band..new_band-1 */
+	for (i = old_band; i < new_band; i++) {
+		data->res_entered[i] = now;
+		data->res_crossings[i]++;
+	}
+
+	/* Left trips new_band..old_band-1 */
+	for (i = new_band; i < old_band; i++) {
+		s64 ms = ktime_ms_delta(now, data->res_entered[i]);
+		int bucket = ms < MSEC_PER_SEC ? 0 : ilog2((u64)ms / MSEC_PER_SEC) + 1;
+
+		data->res_total_ms[i] += ms;
+		data->res_hist[i][min(bucket, RPI_RES_BUCKETS - 1)]++;
+	}
+
+	spin_unlock_irqrestore(&data->res_lock, flags);
+}
+
+static int rpi_acpi_filter(struct rpi_acpi_thermal *data, int raw)
+{
+	ktime_t now = ktime_get();
+	int band = data->filter.band;
+	int temp;
+
+	temp = rpi_thermal_filter(&data->filter, data->trip_temps, data->trip_hyst,
+	                          data->trip_count, raw, ktime_to_ms(now));
+	if (data->filter.band != band)
+		rpi_acpi_residency_update(data, band, data->filter.band, now);
+
+	return temp;
+}
+
+static int rpi_acpi_get_temp(struct thermal_zone_device *tz, int *temp)
+{
+	struct rpi_acpi_thermal *data = tz->devdata;
+	int raw, ret;
+
+	ret = rpi_acpi_sample(data, &raw);
+	if (ret) {
+		trace_rpi_thermal_get_temp(tz->id, 0, 0, ret);
+		return ret;
+	}
+
+	*temp = rpi_acpi_filter(data, raw);
+	trace_rpi_thermal_get_temp(tz->id, raw, *temp, 0);
+
+	return 0;
+}
+
+static struct rpi_acpi_cdev *rpi_acpi_match_cdev(struct rpi_acpi_thermal *data,
+                                                 struct thermal_cooling_device *cdev)
+{
+	int i;
+
+	for (i = 0; i < data->cdev_count; i++) {
+		struct rpi_acpi_cdev *cd = &data->cdevs[i];
+
+		/* pwm-fan registers its cooling device with the ACPI companion */
+		if (cd->adev && cdev->devdata == cd->adev)
+			return cd;
+
+		/* Processor references match the cpufreq cooling device */
+		if (cd->cpu && !strncmp(cdev->type, "cpufreq-", 8))
+			return cd;
+	}
+
+	return NULL;
+}
+
 static int rpi_acpi_bind(struct thermal_zone_device *tz,
                          struct thermal_cooling_device *cdev)
 {
 	struct rpi_acpi_thermal *data = tz->devdata;
-	struct pwm_fan_ctx *ctx;
+	struct rpi_acpi_cdev *cd;
 	int i;
 
 	if (!data) {
@@ -70,25 +386,31 @@ static int rpi_acpi_bind(struct thermal_zone_device *tz,
 		return -EINVAL;
 	}
 
-	/* Fallback: match by cooling device type */
-	if (!strstr(cdev->type, "pwm-fan")) {
+	cd = rpi_acpi_match_cdev(data, cdev);
+	if (!cd)
 		return 0;
-	}
 
-	ctx = cdev->devdata;
-	if (!ctx) {
-		dev_err(&tz->device, "Cooling device context not found\n");
-		return -EINVAL;
-	}
-
-	ctx->tz = tz;
+	if (cd->adev == data->cdev_adev) {
+		mutex_lock(&data->fan_lock);
+		data->fan_cdev = cdev;
+		mutex_unlock(&data->fan_lock);
 
+		if (data->setpoint_mode) {
+			dev_info(&tz->device, "Set-point mode, not binding %s to trips\n", cdev->type);
+			return 0;
+		}
+	}
 
 	dev_info(&tz->device, "Binding cooling device: %s\n", cdev->type);
 
 	for (i = 0; i < data->trip_count; i++) {
-		int ret = thermal_zone_bind_cooling_device(tz, i, cdev,
-				data->min_states[i], data->max_states[i], THERMAL_WEIGHT_DEFAULT);
+		int ret;
+
+		if (!cd->bound[i])
+			continue;
+
+		ret = thermal_zone_bind_cooling_device(tz, i, cdev,
+				cd->max_states[i], cd->min_states[i], cd->weights[i]);
 		if (ret)
 			dev_err(&tz->device, "Failed to bind trip %d: %d\n", i, ret);
 		else
@@ -102,7 +424,7 @@ static int rpi_acpi_unbind(struct thermal_zone_device *tz,
                            struct thermal_cooling_device *cdev)
 {
 	struct rpi_acpi_thermal *data = tz->devdata;
-	struct pwm_fan_ctx *ctx;
+	struct rpi_acpi_cdev *cd;
 	int i;
 
 	if (!data) {
@@ -110,30 +432,37 @@ static int rpi_acpi_unbind(struct thermal_zone_device *tz,
 		return -EINVAL;
 	}
 
-	if (!strstr(cdev->type, "pwm-fan")) {
+	cd = rpi_acpi_match_cdev(data, cdev);
+	if (!cd) {
 		dev_info(&tz->device, "Ignoring unmatched cooling device on unbind: %s\n", cdev->type);
 		return 0;
 	}
 
-	ctx = cdev->devdata;
-	if (!ctx) {
-		dev_err(&tz->device, "Cooling device context not found on unbind\n");
-		return -EINVAL;
+	/* Called before the cooling device goes away, so stop using it here */
+	if (cd->adev == data->cdev_adev) {
+		mutex_lock(&data->fan_lock);
+		data->fan_cdev = NULL;
+		mutex_unlock(&data->fan_lock);
+
+		if (data->setpoint_mode)
+			return 0;
 	}
 
 	dev_info(&tz->device, "Unbinding cooling device: %s\n", cdev->type);
 
 	for (i = 0; i < data->trip_count; i++) {
-		int ret = thermal_zone_unbind_cooling_device(tz, i, cdev);
+		int ret;
+
+		if (!cd->bound[i])
+			continue;
+
+		ret = thermal_zone_unbind_cooling_device(tz, i, cdev);
 		if (ret)
 			dev_err(&tz->device, "Failed to unbind trip %d: %d\n", i, ret);
 		else
 			dev_info(&tz->device, "Unbound trip %d from cooling device\n", i);
 	}
 
-	ctx->tz = NULL;
-
-
 	return 0;
 }
 
@@ -141,20 +470,868 @@ static int rpi_acpi_get_trend(struct thermal_zone_device *tz,
                               const struct thermal_trip *trip,
                               enum thermal_trend *trend)
 {
-	int temp=tz->temperature;
-	
+	*trend = rpi_thermal_trip_trend(tz->temperature, trip->temperature, trip->hysteresis);
+
+	return 0;
+}
+
+static void rpi_acpi_pid_update(struct rpi_acpi_thermal *data, int temp, s64 dt)
+{
+	unsigned int duty;
+	int ret;
+
+	mutex_lock(&data->pid_lock);
+	mutex_lock(&data->fan_lock);
+
+	if (!data->fan_cdev)
+		goto out;
+
+	duty = rpi_thermal_pid_step(&data->pid, temp, dt, MAX_PWM);
+	duty = max(duty, READ_ONCE(data->ff_duty));
+	if (duty != data->pid_duty) {
+		ret = rpi_pwm_fan_set_duty(data->fan_cdev, duty);
+		if (ret)
+			dev_warn(&data->tzd->device, "Failed to set fan duty %u: %d\n", duty, ret);
+		else
+			data->pid_duty = duty;
+	}
+
+out:
+	mutex_unlock(&data->fan_lock);
+	mutex_unlock(&data->pid_lock);
+}
+
+/* Utilization of the online CPUs since the previous call, in percent */
+static int rpi_acpi_cpu_util(struct rpi_acpi_thermal *data)
+{
+	u64 wall = 0, idle = 0, cpu_wall, cpu_idle, dwall, didle;
+	int cpu, util = -1;
+
+	for_each_online_cpu(cpu) {
+		cpu_idle = get_cpu_idle_time_us(cpu, &cpu_wall);
+		if (cpu_idle == -1ULL)
+			return -1;
+		wall += cpu_wall;
+		idle += cpu_idle;
+	}
+
+	dwall = wall - data->ff_last_wall;
+	didle = idle - data->ff_last_idle;
+	if (data->ff_last_wall && dwall && wall > data->ff_last_wall && didle <= dwall)
+		util = div64_u64((dwall - didle) * 100, dwall);
+
+	data->ff_last_wall = wall;
+	data->ff_last_idle = idle;
+
+	return util;
+}
+
+/* Returns true when the duty floor was raised */
+static bool rpi_acpi_feedforward(struct rpi_acpi_thermal *data)
+{
+	unsigned int load, duty, old = data->ff_duty;
+	int util;
 
-	if (temp < trip->temperature - trip->hysteresis)
-		*trend = THERMAL_TREND_DROPPING;
-	else if (temp >= trip->temperature)
-		*trend = THERMAL_TREND_RAISING;
-	else
-		*trend = THERMAL_TREND_STABLE;
+	if (!data->ff_gain)
+		return false;
 
+	util = rpi_acpi_cpu_util(data);
+	if (util >= 0)
+		data->ff_util = util;
+
+	load = data->ff_util;
+	if (time_before(jiffies, READ_ONCE(data->ff_hint_expires)))
+		load = max(load, READ_ONCE(data->ff_hint));
+
+	duty = rpi_thermal_ff_duty(data->ff_gain, data->ff_threshold, load, MAX_PWM);
+
+	if (duty == old)
+		return false;
+
+	WRITE_ONCE(data->ff_duty, duty);
+
+	/* In set-point mode the PID applies the floor to its own output */
+	if (!data->setpoint_mode) {
+		mutex_lock(&data->fan_lock);
+		if (data->fan_cdev && rpi_pwm_fan_set_floor(data->fan_cdev, duty))
+			dev_warn(&data->tzd->device, "Failed to set fan duty floor %u\n", duty);
+		mutex_unlock(&data->fan_lock);
+	}
+
+	return duty > old;
+}
+
+/*
+ * The trend step_wise acts on, taken against the highest trip the zone is
+ * in (the first trip when it is below all of them).
+ */
+static enum thermal_trend rpi_acpi_zone_trend(struct rpi_acpi_thermal *data)
+{
+	enum thermal_trend trend = THERMAL_TREND_STABLE;
+	int band = data->filter.band;
+
+	if (data->trip_count)
+		rpi_acpi_get_trend(data->tzd, &data->trips[band ? band - 1 : 0], &trend);
+
+	return trend;
+}
+
+/* Zeroes when the fan is absent or not bound */
+static void rpi_acpi_fan_status(struct rpi_acpi_thermal *data, unsigned int *state,
+                                unsigned int *duty)
+{
+	*state = 0;
+	*duty = 0;
+
+	mutex_lock(&data->fan_lock);
+	if (data->fan_cdev && rpi_pwm_fan_get_status(data->fan_cdev, state, duty)) {
+		*state = 0;
+		*duty = 0;
+	}
+	mutex_unlock(&data->fan_lock);
+}
+
+static void rpi_acpi_hist_record(struct rpi_acpi_thermal *data, int temp,
+                                 enum thermal_trend trend, unsigned int state,
+                                 unsigned int duty, ktime_t now)
+{
+	struct rpi_thermal_hist_entry *e;
+	u64 head;
+
+	if (!data->hist)
+		return;
+
+	head = data->hist->head;
+	e = &data->hist_entries[head & (RPI_HIST_ENTRIES - 1)];
+
+	e->timestamp_ns = ktime_to_ns(now);
+	e->temp = temp;
+	e->trend = trend;
+	e->trip = data->filter.band;
+	e->state = state;
+	e->duty = duty;
+
+	smp_store_release(&data->hist->head, head + 1);
+}
+
+static void rpi_acpi_telemetry_update(struct rpi_acpi_thermal *data, int temp,
+                                      enum thermal_trend trend, unsigned int state,
+                                      unsigned int duty, ktime_t now)
+{
+	struct rpi_thermal_telemetry *t = data->telemetry;
+
+	if (!t)
+		return;
+
+	WRITE_ONCE(t->seq, t->seq + 1);
+	smp_wmb();
+
+	t->timestamp_ns = ktime_to_ns(now);
+	t->temp = temp;
+	t->trend = trend;
+	t->trip = data->filter.band;
+	t->state = state;
+	t->duty = duty;
+	t->poll_interval_ms = data->poll.interval_ms;
+	t->samples = data->poll_samples;
+	t->fast_samples = data->poll_fast_samples;
+	t->band_changes = data->filter.band_changes;
+	t->suppressed = data->filter.suppressed;
+	t->notify_events = data->notify_events;
+
+	smp_wmb();
+	WRITE_ONCE(t->seq, t->seq + 1);
+}
+
+static void rpi_acpi_notify(struct rpi_acpi_thermal *data, int temp)
+{
+	int band = 0;
+
+	while (band < data->notify_band_count && temp >= data->notify_bands[band])
+		band++;
+
+	if (band == data->notify_band &&
+	    (!data->notify_delta || abs(temp - data->notify_temp) < data->notify_delta))
+		return;
+
+	data->notify_band = band;
+	data->notify_temp = temp;
+	WRITE_ONCE(data->notify_events, data->notify_events + 1);
+
+	sysfs_notify(&data->dev->kobj, NULL, "temp");
+	acpi_bus_generate_netlink_event(RPI_ACPI_THERMAL_CLASS, dev_name(&data->adev->dev),
+	                                RPI_ACPI_NOTIFY_TEMP,
+	                                millicelsius_to_deci_kelvin(temp));
+}
+
+static void rpi_acpi_poll_work(struct work_struct *work)
+{
+	struct rpi_acpi_thermal *data = container_of(work, struct rpi_acpi_thermal, poll_work);
+	enum thermal_trend trend;
+	unsigned int interval_ms, state, duty;
+	ktime_t now;
+	s64 elapsed_ms;
+	bool fast;
+	int temp;
+
+	thermal_zone_device_update(data->tzd, THERMAL_EVENT_UNSPECIFIED);
+
+	now = ktime_get();
+	temp = READ_ONCE(data->tzd->temperature);
+	elapsed_ms = data->poll_samples ? ktime_ms_delta(now, data->poll_last_time) : 0;
+	fast = rpi_thermal_poll_fast(&data->poll, data->trip_temps, data->trip_hyst,
+	                             data->trip_count, temp, data->poll_last_temp, elapsed_ms);
+	if (rpi_acpi_feedforward(data))
+		fast = true;
+
+	/* Actuate first so the history and telemetry show this sample's duty */
+	if (data->setpoint_mode)
+		rpi_acpi_pid_update(data, temp, elapsed_ms);
+
+	trend = rpi_acpi_zone_trend(data);
+	rpi_acpi_fan_status(data, &state, &duty);
+	rpi_acpi_notify(data, temp);
+	rpi_acpi_hist_record(data, temp, trend, state, duty, now);
+
+	data->poll_last_temp = temp;
+	data->poll_last_time = now;
+	data->poll_samples++;
+
+	if (fast)
+		data->poll_fast_samples++;
+	interval_ms = rpi_thermal_poll_next(&data->poll, fast,
+	                                    data->setpoint_mode ? data->pid_period_ms : 0);
+
+	rpi_acpi_telemetry_update(data, temp, trend, state, duty, now);
+
+	if (!READ_ONCE(data->polling))
+		return;
+
+	hrtimer_start_range_ns(&data->poll_timer, ms_to_ktime(interval_ms),
+	                       (u64)interval_ms * NSEC_PER_MSEC / 8,
+	                       HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart rpi_acpi_poll_timer(struct hrtimer *timer)
+{
+	struct rpi_acpi_thermal *data = container_of(timer, struct rpi_acpi_thermal, poll_timer);
+
+	queue_work(system_freezable_power_efficient_wq, &data->poll_work);
+
+	return HRTIMER_NORESTART;
+}
+
+static ssize_t rpi_acpi_hist_read(struct file *file, char __user *buf,
+                                  size_t count, loff_t *ppos)
+{
+	struct rpi_acpi_thermal *data = file->private_data;
+	ssize_t ret;
+
+	ret = debugfs_file_get(file->f_path.dentry);
+	if (ret)
+		return ret;
+
+	ret = simple_read_from_buffer(buf, count, ppos, data->hist, data->hist_size);
+
+	debugfs_file_put(file->f_path.dentry);
+
+	return ret;
+}
+
+/*
+ * The mapped pages hold their own references, so a mapping outlives the
+ * vfree() on remove; only the remap itself has to run while the buffer is
+ * still there.
+ */
+static int rpi_acpi_hist_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct rpi_acpi_thermal *data = file->private_data;
+	int ret;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vm_flags_clear(vma, VM_MAYWRITE);
+
+	ret = debugfs_file_get(file->f_path.dentry);
+	if (ret)
+		return ret;
+
+	ret = remap_vmalloc_range(vma, data->hist, vma->vm_pgoff);
+
+	debugfs_file_put(file->f_path.dentry);
+
+	return ret;
+}
+
+static const struct file_operations rpi_acpi_hist_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = rpi_acpi_hist_read,
+	.mmap = rpi_acpi_hist_mmap,
+	.llseek = default_llseek,
+};
+
+static int rpi_acpi_residency_show(struct seq_file *s, void *unused)
+{
+	struct rpi_acpi_thermal *data = s->private;
+	ktime_t now = ktime_get();
+	int band = READ_ONCE(data->filter.band);
+	unsigned long flags;
+	int i, j;
+
+	seq_puts(s, "trip temp time_ms crossings active");
+	for (j = 0; j < RPI_RES_BUCKETS - 1; j++)
+		seq_printf(s, " <%us", 1U << j);
+	seq_printf(s, " >=%us\n", 1U << (RPI_RES_BUCKETS - 2));
+
+	spin_lock_irqsave(&data->res_lock, flags);
+	for (i = 0; i < data->trip_count; i++) {
+		u64 total = data->res_total_ms[i];
+
+		/* Include the excursion in progress */
+		if (i < band)
+			total += ktime_ms_delta(now, data->res_entered[i]);
+
+		seq_printf(s, "%d %d %llu %llu %d", i, data->trips[i].temperature,
+		           total, data->res_crossings[i], i < band);
+		for (j = 0; j < RPI_RES_BUCKETS; j++)
+			seq_printf(s, " %llu", data->res_hist[i][j]);
+		seq_putc(s, '\n');
+	}
+	spin_unlock_irqrestore(&data->res_lock, flags);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rpi_acpi_residency);
+
+static void rpi_acpi_vfree(void *addr)
+{
+	vfree(addr);
+}
+
+static int rpi_acpi_hist_init(struct device *dev, struct rpi_acpi_thermal *data)
+{
+	struct dentry *file;
+	size_t offset = PAGE_ALIGN(sizeof(*data->hist));
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_DEBUG_FS))
+		return 0;
+
+	data->hist_size = offset + RPI_HIST_ENTRIES * sizeof(*data->hist_entries);
+	data->hist = vmalloc_user(data->hist_size);
+	if (!data->hist)
+		return -ENOMEM;
+
+	ret = devm_add_action_or_reset(dev, rpi_acpi_vfree, data->hist);
+	if (ret)
+		return ret;
+
+	data->hist->magic = RPI_THERMAL_HIST_MAGIC;
+	data->hist->version = RPI_THERMAL_HIST_VERSION;
+	data->hist->entry_size = sizeof(*data->hist_entries);
+	data->hist->entries = RPI_HIST_ENTRIES;
+	data->hist->data_offset = offset;
+	data->hist_entries = (void *)data->hist + offset;
+
+	/*
+	 * The proxy does not forward mmap, so the file is unsafe and both read
+	 * and mmap take debugfs_file_get() themselves
+	 */
+	data->debugfs = debugfs_create_dir(DRIVER_NAME, NULL);
+	file = debugfs_create_file_unsafe("history", 0400, data->debugfs, data,
+	                                  &rpi_acpi_hist_fops);
+	if (!IS_ERR(file))
+		d_inode(file)->i_size = data->hist_size;
+
+	debugfs_create_file("residency", 0444, data->debugfs, data,
+	                    &rpi_acpi_residency_fops);
+
+	return 0;
+}
+
+static void rpi_acpi_telemetry_release_buf(struct kref *ref)
+{
+	struct rpi_acpi_telemetry_buf *buf = container_of(ref, struct rpi_acpi_telemetry_buf, ref);
+
+	vfree(buf->page);
+	kfree(buf);
+}
+
+static void rpi_acpi_telemetry_put(void *buf)
+{
+	kref_put(&((struct rpi_acpi_telemetry_buf *)buf)->ref, rpi_acpi_telemetry_release_buf);
+}
+
+static int rpi_acpi_telemetry_open(struct inode *inode, struct file *file)
+{
+	struct miscdevice *misc = file->private_data;
+	struct rpi_acpi_thermal *data = container_of(misc, struct rpi_acpi_thermal, misc);
+
+	/* misc_open() holds misc_mtx, so misc_deregister() cannot race this */
+	kref_get(&data->telemetry_buf->ref);
+	file->private_data = data->telemetry_buf;
+
+	return 0;
+}
+
+static int rpi_acpi_telemetry_release(struct inode *inode, struct file *file)
+{
+	rpi_acpi_telemetry_put(file->private_data);
 
 	return 0;
 }
 
+static int rpi_acpi_telemetry_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct rpi_acpi_telemetry_buf *buf = file->private_data;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vm_flags_clear(vma, VM_MAYWRITE);
+
+	return remap_vmalloc_range(vma, buf->page, vma->vm_pgoff);
+}
+
+static const struct file_operations rpi_acpi_telemetry_fops = {
+	.owner = THIS_MODULE,
+	.open = rpi_acpi_telemetry_open,
+	.release = rpi_acpi_telemetry_release,
+	.mmap = rpi_acpi_telemetry_mmap,
+	.llseek = noop_llseek,
+};
+
+static int rpi_acpi_telemetry_init(struct device *dev, struct rpi_acpi_thermal *data)
+{
+	struct rpi_acpi_telemetry_buf *buf;
+	int ret;
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	kref_init(&buf->ref);
+	buf->page = vmalloc_user(PAGE_SIZE);
+	if (!buf->page) {
+		kfree(buf);
+		return -ENOMEM;
+	}
+
+	/* Drops the driver's reference; open files keep the page alive */
+	ret = devm_add_action_or_reset(dev, rpi_acpi_telemetry_put, buf);
+	if (ret)
+		return ret;
+
+	data->telemetry_buf = buf;
+	data->telemetry = buf->page;
+
+	data->telemetry->magic = RPI_THERMAL_TELEMETRY_MAGIC;
+	data->telemetry->version = RPI_THERMAL_TELEMETRY_VERSION;
+	data->telemetry->size = sizeof(*data->telemetry);
+
+	data->misc.minor = MISC_DYNAMIC_MINOR;
+	data->misc.name = "rpi-thermal";
+	data->misc.fops = &rpi_acpi_telemetry_fops;
+	data->misc.mode = 0444;
+	data->misc.parent = dev;
+
+	return misc_register(&data->misc);
+}
+
+static void rpi_acpi_read_poll_config(struct device *dev, struct rpi_acpi_thermal *data)
+{
+	data->poll.min_ms = RPI_POLL_MIN_MS;
+	data->poll.max_ms = RPI_POLL_MAX_MS;
+	data->poll.trip_margin = RPI_POLL_TRIP_MARGIN;
+	data->poll.rise_rate = RPI_POLL_RISE_RATE;
+
+	device_property_read_u32(dev, "polling-min-ms", &data->poll.min_ms);
+	device_property_read_u32(dev, "polling-max-ms", &data->poll.max_ms);
+	device_property_read_u32(dev, "polling-trip-margin", &data->poll.trip_margin);
+	device_property_read_u32(dev, "polling-rise-rate", &data->poll.rise_rate);
+
+	if (!data->poll.min_ms)
+		data->poll.min_ms = RPI_POLL_MIN_MS;
+	if (data->poll.max_ms < data->poll.min_ms)
+		data->poll.max_ms = data->poll.min_ms;
+
+	data->poll.interval_ms = data->poll.min_ms;
+}
+
+static void rpi_acpi_read_filter_config(struct device *dev, struct rpi_acpi_thermal *data)
+{
+	data->filter.tau_ms = RPI_FILTER_TAU_MS;
+	data->filter.dwell_ms = RPI_STATE_DWELL_MS;
+
+	device_property_read_u32(dev, "filter-time-constant-ms", &data->filter.tau_ms);
+	device_property_read_u32(dev, "state-dwell-ms", &data->filter.dwell_ms);
+}
+
+static void rpi_acpi_read_pid_config(struct device *dev, struct rpi_acpi_thermal *data)
+{
+	const char *mode;
+
+	data->pid.setpoint = RPI_PID_SETPOINT;
+	data->pid.kp = RPI_PID_KP;
+	data->pid.ki = RPI_PID_KI;
+	data->pid.kd = RPI_PID_KD;
+	data->pid_period_ms = RPI_PID_PERIOD_MS;
+	data->pid_duty = MAX_PWM;
+
+	if (!device_property_read_string(dev, "control-mode", &mode) &&
+	    !strcmp(mode, "setpoint"))
+		data->setpoint_mode = true;
+
+	device_property_read_u32(dev, "setpoint-temp", &data->pid.setpoint);
+	device_property_read_u32(dev, "pid-kp", &data->pid.kp);
+	device_property_read_u32(dev, "pid-ki", &data->pid.ki);
+	device_property_read_u32(dev, "pid-kd", &data->pid.kd);
+	device_property_read_u32(dev, "pid-period-ms", &data->pid_period_ms);
+
+	if (!data->pid_period_ms)
+		data->pid_period_ms = RPI_PID_PERIOD_MS;
+}
+
+static void rpi_acpi_read_ff_config(struct device *dev, struct rpi_acpi_thermal *data)
+{
+	data->ff_gain = RPI_FF_GAIN;
+	data->ff_threshold = RPI_FF_THRESHOLD;
+	data->ff_hint_ms = RPI_FF_HINT_MS;
+	data->ff_hint_expires = jiffies;
+
+	device_property_read_u32(dev, "feedforward-gain", &data->ff_gain);
+	device_property_read_u32(dev, "feedforward-threshold", &data->ff_threshold);
+	device_property_read_u32(dev, "feedforward-hint-ms", &data->ff_hint_ms);
+
+	data->ff_gain = min_t(u32, data->ff_gain, MAX_PWM);
+	data->ff_threshold = min_t(u32, data->ff_threshold, 99);
+}
+
+static void rpi_acpi_read_notify_config(struct device *dev, struct rpi_acpi_thermal *data)
+{
+	int count;
+
+	data->notify_delta = RPI_NOTIFY_DELTA;
+	device_property_read_u32(dev, "notify-delta", &data->notify_delta);
+
+	count = device_property_count_u32(dev, "notify-bands");
+	if (count > 0 && count <= MAX_TRIPS &&
+	    !device_property_read_u32_array(dev, "notify-bands", data->notify_bands, count)) {
+		data->notify_band_count = count;
+	} else {
+		if (count > 0)
+			dev_warn(dev, "Invalid notify-bands, using the active trips\n");
+		memcpy(data->notify_bands, data->trip_temps, sizeof(s32) * data->trip_count);
+		data->notify_band_count = data->trip_count;
+	}
+
+	/* Force an event on the first sample */
+	data->notify_band = -1;
+}
+
+static ssize_t rpi_acpi_pid_param_store(struct device *dev, const char *buf,
+                                        size_t count, s32 *param)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+	s32 val;
+	int ret;
+
+	ret = kstrtos32(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&data->pid_lock);
+	*param = val;
+	mutex_unlock(&data->pid_lock);
+
+	return count;
+}
+
+#define RPI_ACPI_PID_ATTR(_name, _field)					\
+static ssize_t _name##_show(struct device *dev,					\
+                            struct device_attribute *attr, char *buf)		\
+{										\
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);			\
+										\
+	return sysfs_emit(buf, "%d\n", READ_ONCE(data->_field));		\
+}										\
+static ssize_t _name##_store(struct device *dev,				\
+                             struct device_attribute *attr,			\
+                             const char *buf, size_t count)			\
+{										\
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);			\
+										\
+	return rpi_acpi_pid_param_store(dev, buf, count, &data->_field);	\
+}										\
+static DEVICE_ATTR_RW(_name)
+
+RPI_ACPI_PID_ATTR(setpoint_temp, pid.setpoint);
+RPI_ACPI_PID_ATTR(pid_kp, pid.kp);
+RPI_ACPI_PID_ATTR(pid_ki, pid.ki);
+RPI_ACPI_PID_ATTR(pid_kd, pid.kd);
+
+static ssize_t pid_duty_show(struct device *dev,
+                             struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(data->pid_duty));
+}
+static DEVICE_ATTR_RO(pid_duty);
+
+static ssize_t load_hint_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	if (time_after_eq(jiffies, READ_ONCE(data->ff_hint_expires)))
+		return sysfs_emit(buf, "0\n");
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(data->ff_hint));
+}
+
+/* Expected load in percent, e.g. written by a job launcher before it starts */
+static ssize_t load_hint_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+	unsigned int hint;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &hint);
+	if (ret)
+		return ret;
+	if (hint > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(data->ff_hint, hint);
+	WRITE_ONCE(data->ff_hint_expires, jiffies + msecs_to_jiffies(data->ff_hint_ms));
+
+	/* Apply it now rather than at the next, possibly backed-off, sample */
+	if (READ_ONCE(data->polling))
+		queue_work(system_freezable_power_efficient_wq, &data->poll_work);
+
+	return count;
+}
+static DEVICE_ATTR_RW(load_hint);
+
+static ssize_t ff_util_show(struct device *dev,
+                            struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(data->ff_util));
+}
+static DEVICE_ATTR_RO(ff_util);
+
+static ssize_t ff_duty_show(struct device *dev,
+                            struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(data->ff_duty));
+}
+static DEVICE_ATTR_RO(ff_duty);
+
+static ssize_t poll_interval_ms_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", data->poll.interval_ms);
+}
+static DEVICE_ATTR_RO(poll_interval_ms);
+
+static ssize_t poll_samples_show(struct device *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%llu\n", data->poll_samples);
+}
+static DEVICE_ATTR_RO(poll_samples);
+
+static ssize_t poll_fast_samples_show(struct device *dev,
+                                      struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%llu\n", data->poll_fast_samples);
+}
+static DEVICE_ATTR_RO(poll_fast_samples);
+
+static ssize_t filter_band_changes_show(struct device *dev,
+                                        struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%llu\n", data->filter.band_changes);
+}
+static DEVICE_ATTR_RO(filter_band_changes);
+
+static ssize_t sample_reads_show(struct device *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%llu\n", data->sample_reads);
+}
+static DEVICE_ATTR_RO(sample_reads);
+
+static ssize_t sample_hits_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%llu\n", data->sample_hits);
+}
+static DEVICE_ATTR_RO(sample_hits);
+
+static ssize_t filter_suppressed_show(struct device *dev,
+                                      struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%llu\n", data->filter.suppressed);
+}
+static DEVICE_ATTR_RO(filter_suppressed);
+
+static ssize_t temp_show(struct device *dev,
+                         struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(data->tzd->temperature));
+}
+static DEVICE_ATTR_RO(temp);
+
+static ssize_t notify_events_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%llu\n", READ_ONCE(data->notify_events));
+}
+static DEVICE_ATTR_RO(notify_events);
+
+static struct attribute *rpi_acpi_attrs[] = {
+	&dev_attr_temp.attr,
+	&dev_attr_notify_events.attr,
+	&dev_attr_poll_interval_ms.attr,
+	&dev_attr_poll_samples.attr,
+	&dev_attr_poll_fast_samples.attr,
+	&dev_attr_filter_band_changes.attr,
+	&dev_attr_filter_suppressed.attr,
+	&dev_attr_sample_reads.attr,
+	&dev_attr_sample_hits.attr,
+	NULL
+};
+
+static struct attribute *rpi_acpi_pid_attrs[] = {
+	&dev_attr_setpoint_temp.attr,
+	&dev_attr_pid_kp.attr,
+	&dev_attr_pid_ki.attr,
+	&dev_attr_pid_kd.attr,
+	&dev_attr_pid_duty.attr,
+	NULL
+};
+
+static struct attribute *rpi_acpi_ff_attrs[] = {
+	&dev_attr_load_hint.attr,
+	&dev_attr_ff_util.attr,
+	&dev_attr_ff_duty.attr,
+	NULL
+};
+
+static umode_t rpi_acpi_ff_attr_visible(struct kobject *kobj,
+                                        struct attribute *attr, int n)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(kobj_to_dev(kobj));
+
+	return data->ff_gain ? attr->mode : 0;
+}
+
+static umode_t rpi_acpi_pid_attr_visible(struct kobject *kobj,
+                                         struct attribute *attr, int n)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(kobj_to_dev(kobj));
+
+	return data->setpoint_mode ? attr->mode : 0;
+}
+
+static const struct attribute_group rpi_acpi_group = {
+	.attrs = rpi_acpi_attrs,
+};
+
+static const struct attribute_group rpi_acpi_pid_group = {
+	.attrs = rpi_acpi_pid_attrs,
+	.is_visible = rpi_acpi_pid_attr_visible,
+};
+
+static const struct attribute_group rpi_acpi_ff_group = {
+	.attrs = rpi_acpi_ff_attrs,
+	.is_visible = rpi_acpi_ff_attr_visible,
+};
+
+static const struct attribute_group *rpi_acpi_groups[] = {
+	&rpi_acpi_group,
+	&rpi_acpi_pid_group,
+	&rpi_acpi_ff_group,
+	NULL
+};
+
+/*
+ * hwmon view: the cached raw sample and the first active trip. All trips are
+ * active, so there is no critical temperature to report.
+ */
+static umode_t rpi_acpi_hwmon_is_visible(const void *drvdata, enum hwmon_sensor_types type,
+                                         u32 attr, int channel)
+{
+	const struct rpi_acpi_thermal *data = drvdata;
+
+	if (attr != hwmon_temp_input && !data->trip_count)
+		return 0;
+
+	return 0444;
+}
+
+static int rpi_acpi_hwmon_read(struct device *dev, enum hwmon_sensor_types type,
+                               u32 attr, int channel, long *val)
+{
+	struct rpi_acpi_thermal *data = dev_get_drvdata(dev);
+	int temp, ret;
+
+	switch (attr) {
+	case hwmon_temp_input:
+		ret = rpi_acpi_sample(data, &temp);
+		if (ret)
+			return ret;
+		*val = temp;
+		return 0;
+	case hwmon_temp_max:
+		*val = data->trips[0].temperature;
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static const struct hwmon_channel_info * const rpi_acpi_hwmon_info[] = {
+	HWMON_CHANNEL_INFO(temp, HWMON_T_INPUT | HWMON_T_MAX),
+	NULL
+};
+
+static const struct hwmon_ops rpi_acpi_hwmon_ops = {
+	.is_visible = rpi_acpi_hwmon_is_visible,
+	.read = rpi_acpi_hwmon_read,
+};
+
+static const struct hwmon_chip_info rpi_acpi_hwmon_chip = {
+	.ops = &rpi_acpi_hwmon_ops,
+	.info = rpi_acpi_hwmon_info,
+};
+
 static struct thermal_zone_device_ops rpi_acpi_thermal_ops = {
 	.get_temp = rpi_acpi_get_temp,
 	.bind = rpi_acpi_bind,
@@ -162,16 +1339,17 @@ static struct thermal_zone_device_ops rpi_acpi_thermal_ops = {
 	.get_trend = rpi_acpi_get_trend,
 };
 
-static acpi_handle find_cooling_device_handle(struct device *dev, acpi_handle parent)
+static int find_cooling_device_handles(struct device *dev, acpi_handle parent,
+                                       acpi_handle *handles, int max)
 {
 	acpi_status status;
 	struct acpi_buffer buf = { ACPI_ALLOCATE_BUFFER, NULL };
 	union acpi_object *dsd;
-	acpi_handle result = NULL;
+	int result = 0;
 
 	status = acpi_evaluate_object(parent, "_DSD", NULL, &buf);
 	if (ACPI_FAILURE(status))
-		return NULL;
+		return 0;
 
 	dsd = buf.pointer;
 	if (!dsd || dsd->type != ACPI_TYPE_PACKAGE || dsd->package.count < 2)
@@ -197,11 +1375,19 @@ static acpi_handle find_cooling_device_handle(struct device *dev, acpi_handle pa
 
 		if (!strcmp(key->string.pointer, "cooling-device")) {
 			if (val->type == ACPI_TYPE_LOCAL_REFERENCE) {
-				result = val->reference.handle;
-			} else if (val->type == ACPI_TYPE_PACKAGE &&
-			           val->package.count > 0 &&
-			           val->package.elements[0].type == ACPI_TYPE_LOCAL_REFERENCE) {
-				result = val->package.elements[0].reference.handle;
+				handles[result++] = val->reference.handle;
+			} else if (val->type == ACPI_TYPE_PACKAGE) {
+				for (int j = 0; j < val->package.count && result < max; j++) {
+					union acpi_object *ref = &val->package.elements[j];
+
+					if (ref->type != ACPI_TYPE_LOCAL_REFERENCE) {
+						dev_warn(dev, "cooling-device entry %d is not a reference\n", j);
+						continue;
+					}
+					handles[result++] = ref->reference.handle;
+				}
+				if (val->package.count > max)
+					dev_warn(dev, "Only the first %d cooling devices are used\n", max);
 			}
 			break;
 		}
@@ -212,11 +1398,129 @@ out:
 	return result;
 }
 
+/*
+ * Reads a per-trip, per-device table into flat[] and returns the number of
+ * columns: cdev_count, or 1 for the legacy single-device layout.
+ */
+static int rpi_acpi_read_cooling_table(struct device *dev, const char *prop,
+                                       struct rpi_acpi_thermal *data, u32 *flat)
+{
+	int cols = data->cdev_count;
+	int ret;
+
+	if (device_property_count_u32(dev, prop) == data->trip_count)
+		cols = 1;
+
+	ret = check_array_length(dev, prop, data->trip_count * cols);
+	if (ret)
+		return ret;
+
+	ret = device_property_read_u32_array(dev, prop, flat, data->trip_count * cols);
+	if (ret)
+		return ret;
+
+	return cols;
+}
+
+static int rpi_acpi_read_cooling_config(struct device *dev, struct rpi_acpi_thermal *data)
+{
+	acpi_handle handles[MAX_COOLING_DEVS];
+	u32 min_states[MAX_TRIPS * MAX_COOLING_DEVS];
+	u32 max_states[MAX_TRIPS * MAX_COOLING_DEVS];
+	u32 weights[MAX_TRIPS * MAX_COOLING_DEVS];
+	int cols, wcols = 0;
+	int i, j;
+
+	data->cdev_count = find_cooling_device_handles(dev, data->adev->handle,
+	                                               handles, MAX_COOLING_DEVS);
+	if (!data->cdev_count)
+		return -ENODEV;
+
+	cols = rpi_acpi_read_cooling_table(dev, "cooling-min-states", data, min_states);
+	if (cols < 0)
+		return cols;
+	if (rpi_acpi_read_cooling_table(dev, "cooling-max-states", data, max_states) != cols) {
+		dev_err(dev, "cooling-max-states does not match cooling-min-states\n");
+		return -EINVAL;
+	}
+	if (cols < data->cdev_count)
+		dev_warn(dev, "Single-column cooling states, binding only the first cooling device\n");
+
+	if (device_property_present(dev, "cooling-weights")) {
+		wcols = rpi_acpi_read_cooling_table(dev, "cooling-weights", data, weights);
+		if (wcols < 0)
+			return wcols;
+	}
+
+	for (j = 0; j < data->cdev_count; j++) {
+		struct rpi_acpi_cdev *cd = &data->cdevs[j];
+
+		/* Firmware hides the fan with _STA on nodes without a PoE HAT */
+		cd->adev = acpi_fetch_acpi_dev(handles[j]);
+		if (!cd->adev || !cd->adev->status.present) {
+			dev_info(dev, "Cooling device %d not present, skipping\n", j);
+			cd->adev = NULL;
+			continue;
+		}
+
+		cd->cpu = !strcmp(acpi_device_hid(cd->adev), RPI_CPU_HID) ||
+		          !strcmp(acpi_device_hid(cd->adev), RPI_CPU_OBJECT_HID);
+		if (!cd->cpu && !data->cdev_adev)
+			data->cdev_adev = cd->adev;
+
+		for (i = 0; i < data->trip_count; i++) {
+			if (j >= cols)
+				continue;
+
+			cd->min_states[i] = min_states[i * cols + j];
+			cd->max_states[i] = max_states[i * cols + j];
+			cd->bound[i] = true;
+			cd->weights[i] = THERMAL_WEIGHT_DEFAULT;
+
+			if (j < wcols) {
+				cd->weights[i] = weights[i * wcols + j];
+				cd->bound[i] = cd->weights[i] != 0;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void rpi_acpi_map_sensor(struct platform_device *pdev,
+                                struct rpi_acpi_thermal *data)
+{
+	struct resource *res;
+	void __iomem *regs;
+
+	data->sensor_offset = RPI_SENSOR_OFFSET;
+	data->sensor_slope = RPI_SENSOR_SLOPE;
+	device_property_read_u32(&pdev->dev, "sensor-offset", &data->sensor_offset);
+	device_property_read_u32(&pdev->dev, "sensor-slope", &data->sensor_slope);
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	if (!res) {
+		dev_info(&pdev->dev, "No sensor register in _CRS, using _TMP\n");
+		return;
+	}
+
+	regs = devm_ioremap_resource(&pdev->dev, res);
+	if (IS_ERR(regs)) {
+		dev_warn(&pdev->dev, "Failed to map sensor register (%ld), using _TMP\n",
+		         PTR_ERR(regs));
+		return;
+	}
+
+	data->sensor = regs;
+	dev_info(&pdev->dev, "Reading temperature directly from %pR\n", res);
+}
+
 static int rpi_acpi_probe(struct platform_device *pdev)
 {
 	struct rpi_acpi_thermal *data;
 	struct acpi_device *adev = ACPI_COMPANION(&pdev->dev);
-	acpi_handle fan_handle;
+	struct thermal_zone_params tzp = { .no_hwmon = true };
+	struct device *hwmon;
 	int ret, i;
 
 	if (!adev)
@@ -227,6 +1531,7 @@ static int rpi_acpi_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	data->adev = adev;
+	data->dev = &pdev->dev;
 	platform_set_drvdata(pdev, data);
 
 	ret = device_property_count_u32(&pdev->dev, "active-trip-temps");
@@ -236,9 +1541,7 @@ static int rpi_acpi_probe(struct platform_device *pdev)
 		return -EINVAL;
 	data->trip_count = ret;
 
-	if (device_property_read_u32_array(&pdev->dev, "active-trip-temps", data->trip_temps, data->trip_count) ||
-	    device_property_read_u32_array(&pdev->dev, "cooling-min-states", data->min_states, data->trip_count) ||
-	    device_property_read_u32_array(&pdev->dev, "cooling-max-states", data->max_states, data->trip_count)) {
+	if (device_property_read_u32_array(&pdev->dev, "active-trip-temps", data->trip_temps, data->trip_count)) {
 		dev_err(&pdev->dev, "Failed to read cooling properties\n");
 		return -EINVAL;
 	}
@@ -247,25 +1550,41 @@ static int rpi_acpi_probe(struct platform_device *pdev)
 	if (ret < 0)
 		memset(data->trip_hyst, 0, sizeof(s32) * data->trip_count);
 
+	rpi_acpi_map_sensor(pdev, data);
+	rpi_acpi_read_poll_config(&pdev->dev, data);
+	rpi_acpi_read_filter_config(&pdev->dev, data);
+	rpi_acpi_read_pid_config(&pdev->dev, data);
+	rpi_acpi_read_ff_config(&pdev->dev, data);
+	rpi_acpi_read_notify_config(&pdev->dev, data);
+	mutex_init(&data->pid_lock);
+	mutex_init(&data->fan_lock);
+	mutex_init(&data->sample_lock);
+	spin_lock_init(&data->res_lock);
+
+	data->sample_max_age_ms = RPI_SAMPLE_MAX_AGE_MS;
+	device_property_read_u32(&pdev->dev, "sample-max-age-ms", &data->sample_max_age_ms);
+
+	hrtimer_init(&data->poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	data->poll_timer.function = rpi_acpi_poll_timer;
+	INIT_WORK(&data->poll_work, rpi_acpi_poll_work);
+
 	for (i = 0; i < data->trip_count; i++) {
 		data->trips[i].type = THERMAL_TRIP_ACTIVE;
 		data->trips[i].temperature = data->trip_temps[i];
 		data->trips[i].hysteresis = data->trip_hyst[i];
 	}
 
-	fan_handle = find_cooling_device_handle(&pdev->dev, data->adev->handle);
-	if (!fan_handle)
-		return -ENODEV;
+	ret = rpi_acpi_read_cooling_config(&pdev->dev, data);
+	if (ret)
+		return ret;
 
-	data->cdev_adev = acpi_fetch_acpi_dev(fan_handle);
-	if (!data->cdev_adev) {
-		dev_err(&pdev->dev, "Cooling device companion fetch failed\n");
-		return -ENODEV;
-	}
+	if (!data->cdev_adev)
+		dev_info(&pdev->dev, "No fan present, monitoring without active cooling\n");
 
+	/* The driver registers its own hwmon device on the sample cache */
 	data->tzd = thermal_zone_device_register_with_trips(DRIVER_NAME,
 		data->trips, data->trip_count, 0, data,
-		&rpi_acpi_thermal_ops, NULL, 0, 1000);
+		&rpi_acpi_thermal_ops, &tzp, 0, 0);
 
 	if (IS_ERR(data->tzd)) {
 		dev_err(&pdev->dev, "Failed to register thermal zone\n");
@@ -291,12 +1610,58 @@ static int rpi_acpi_probe(struct platform_device *pdev)
 		return ret;
 	}
 
+	ret = rpi_acpi_hist_init(&pdev->dev, data);
+	if (ret) {
+		dev_err(&pdev->dev, "Failed to set up thermal history: %d\n", ret);
+		thermal_zone_device_unregister(data->tzd);
+		return ret;
+	}
+
+	if (IS_REACHABLE(CONFIG_HWMON)) {
+		hwmon = devm_hwmon_device_register_with_info(&pdev->dev, "rpi_thermal", data,
+		                                             &rpi_acpi_hwmon_chip, NULL);
+		if (IS_ERR(hwmon))
+			dev_warn(&pdev->dev, "Failed to register hwmon device: %ld\n",
+			         PTR_ERR(hwmon));
+	}
+
+	ret = rpi_acpi_telemetry_init(&pdev->dev, data);
+	if (ret) {
+		dev_err(&pdev->dev, "Failed to register telemetry device: %d\n", ret);
+		debugfs_remove_recursive(data->debugfs);
+		thermal_zone_device_unregister(data->tzd);
+		return ret;
+	}
+
+	/* The zone is not polled by the core; the adaptive poller drives it */
+	WRITE_ONCE(data->polling, true);
+	queue_work(system_freezable_power_efficient_wq, &data->poll_work);
+
+	dev_info(&pdev->dev, "Adaptive polling between %u and %u ms\n",
+	         data->poll.min_ms, data->poll.max_ms);
+
+	if (data->setpoint_mode)
+		dev_info(&pdev->dev, "Set-point mode, holding %d mC\n", data->pid.setpoint);
+
 	return 0;
 }
 
 static int rpi_acpi_remove(struct platform_device *pdev)
 {
 	struct rpi_acpi_thermal *data = platform_get_drvdata(pdev);
+
+	if (data) {
+		misc_deregister(&data->misc);
+		debugfs_remove_recursive(data->debugfs);
+	}
+
+	if (data && READ_ONCE(data->polling)) {
+		WRITE_ONCE(data->polling, false);
+		cancel_work_sync(&data->poll_work);
+		hrtimer_cancel(&data->poll_timer);
+		cancel_work_sync(&data->poll_work);
+	}
+
 	if (data && data->tzd)
 		thermal_zone_device_unregister(data->tzd);
 	return 0;
@@ -312,6 +1677,8 @@ static struct platform_driver rpi_acpi_driver = {
 	.driver = {
 		.name = DRIVER_NAME,
 		.acpi_match_table = rpi_acpi_ids,
+		.dev_groups = rpi_acpi_groups,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = rpi_acpi_probe,
 	.remove = rpi_acpi_remove,
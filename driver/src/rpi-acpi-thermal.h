@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef RPI_ACPI_THERMAL_H
+#define RPI_ACPI_THERMAL_H
+
+#include <linux/types.h>
+
+/*
+ * Thermal history exported by rpi-acpi-thermal through
+ * <debugfs>/rpi_acpi_thermal/history, readable or mmap-able read-only.
+ *
+ * The file starts with struct rpi_thermal_hist_header; the records follow
+ * at data_offset as a ring of 'entries' (a power of two) fixed-size
+ * struct rpi_thermal_hist_entry. The driver is the only writer: it fills
+ * record number 'head' at index head % entries and then publishes head + 1
+ * with release semantics. A reader loads head (acquire), copies the records
+ * it wants and loads head again as h2; records numbered below
+ * h2 - entries + 1 may have been overwritten during the copy.
+ */
+#define RPI_THERMAL_HIST_MAGIC		0x48495052	/* "RPIH" */
+#define RPI_THERMAL_HIST_VERSION	1
+
+struct rpi_thermal_hist_header {
+	__u32 magic;
+	__u32 version;
+	__u32 entry_size;
+	__u32 entries;
+	__u32 data_offset;
+	__u32 reserved;
+	__u64 head;		/* number of records written so far */
+};
+
+struct rpi_thermal_hist_entry {
+	__u64 timestamp_ns;	/* CLOCK_MONOTONIC */
+	__s32 temp;		/* zone temperature, mC */
+	__u8 trend;		/* enum thermal_trend */
+	__u8 trip;		/* number of active trips the zone is in */
+	__u8 state;		/* fan cooling state */
+	__u8 duty;		/* fan PWM duty, 0-255 */
+};
+
+/*
+ * Live telemetry page, mmap-able read-only from /dev/rpi-thermal.
+ *
+ * The poll work is the only writer and brackets each update with two
+ * increments of seq, so seq is odd while the page is being written. A
+ * reader loads seq (acquire), retries while it is odd, copies the fields,
+ * issues a read barrier and retries if seq has changed.
+ */
+#define RPI_THERMAL_TELEMETRY_MAGIC	0x54505052	/* "RPPT" */
+#define RPI_THERMAL_TELEMETRY_VERSION	1
+
+struct rpi_thermal_telemetry {
+	__u32 magic;
+	__u32 version;
+	__u32 seq;
+	__u32 size;		/* sizeof(struct rpi_thermal_telemetry) */
+	__u64 timestamp_ns;	/* CLOCK_MONOTONIC of the last sample */
+	__s32 temp;		/* filtered zone temperature, mC */
+	__u8 trend;		/* enum thermal_trend */
+	__u8 trip;		/* number of active trips the zone is in */
+	__u8 state;		/* fan cooling state */
+	__u8 duty;		/* fan PWM duty, 0-255 */
+	__u32 poll_interval_ms;
+	__u32 reserved;
+	__u64 samples;
+	__u64 fast_samples;
+	__u64 band_changes;
+	__u64 suppressed;
+	__u64 notify_events;
+};
+
+#endif // RPI_ACPI_THERMAL_H
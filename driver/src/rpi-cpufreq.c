@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * rpi-cpufreq.c - Raspberry Pi CPU frequency scaling over the ACPI mailbox
+ *
+ * The ARM clock is owned by the VideoCore firmware, so on an ACPI boot the
+ * only way to change it is the clock rate property tags. This builds an OPP
+ * table in 100 MHz steps between the firmware minimum and maximum rates,
+ * shared by all cores, and registers a cpufreq cooling device for it.
+ *
+ * Setting the rate is a mailbox transaction and may sleep, so there is no
+ * fast_switch: schedutil changes the rate from its worker thread.
+ */
+
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu_cooling.h>
+#include <linux/pm_opp.h>
+#include <linux/units.h>
+#include "rpi-mailbox.h"
+
+#define DRIVER_NAME "rpi-cpufreq"
+
+#define RPI_CPUFREQ_CLK_ARM		3
+#define RPI_CPUFREQ_STEP_HZ		(100 * HZ_PER_MHZ)
+#define RPI_CPUFREQ_LATENCY_NS		355000
+
+struct rpi_cpufreq_clk_msg {
+	__le32 id;
+	__le32 rate;
+	__le32 skip_turbo;	/* SET_CLOCK_RATE only */
+};
+
+static struct rpi_mbox *rpi_cpufreq_fw;
+static struct thermal_cooling_device *rpi_cpufreq_cdev;
+
+static int rpi_cpufreq_clk_property(u32 tag, u32 *rate)
+{
+	struct rpi_cpufreq_clk_msg msg = {
+		.id = cpu_to_le32(RPI_CPUFREQ_CLK_ARM),
+		.rate = cpu_to_le32(*rate),
+	};
+	int ret;
+
+	ret = rpi_mbox_property(rpi_cpufreq_fw, tag, &msg,
+	                        tag == RPI_MBOX_TAG_SET_CLOCK_RATE ? sizeof(msg) : 2 * sizeof(u32));
+	if (ret)
+		return ret;
+
+	*rate = le32_to_cpu(msg.rate);
+
+	return *rate ? 0 : -EIO;
+}
+
+static unsigned int rpi_cpufreq_get(unsigned int cpu)
+{
+	u32 rate = 0;
+
+	if (rpi_cpufreq_clk_property(RPI_MBOX_TAG_GET_CLOCK_RATE, &rate))
+		return 0;
+
+	return rate / HZ_PER_KHZ;
+}
+
+static int rpi_cpufreq_target_index(struct cpufreq_policy *policy, unsigned int index)
+{
+	u32 rate = policy->freq_table[index].frequency * HZ_PER_KHZ;
+
+	return rpi_cpufreq_clk_property(RPI_MBOX_TAG_SET_CLOCK_RATE, &rate);
+}
+
+static int rpi_cpufreq_init(struct cpufreq_policy *policy)
+{
+	struct cpufreq_frequency_table *freq_table;
+	struct device *cpu_dev;
+	int ret;
+
+	cpu_dev = get_cpu_device(policy->cpu);
+	if (!cpu_dev)
+		return -ENODEV;
+
+	ret = dev_pm_opp_init_cpufreq_table(cpu_dev, &freq_table);
+	if (ret) {
+		dev_err(cpu_dev, "Failed to init cpufreq table: %d\n", ret);
+		return ret;
+	}
+
+	/* All cores are clocked by the one ARM clock */
+	cpufreq_generic_init(policy, freq_table, RPI_CPUFREQ_LATENCY_NS);
+	policy->dvfs_possible_from_any_cpu = true;
+
+	return 0;
+}
+
+static void rpi_cpufreq_ready(struct cpufreq_policy *policy)
+{
+	/* CPUFREQ_IS_COOLING_DEV needs a DT node, so register it here */
+	rpi_cpufreq_cdev = cpufreq_cooling_register(policy);
+	if (IS_ERR(rpi_cpufreq_cdev)) {
+		pr_warn("%s: Failed to register cooling device: %ld\n", DRIVER_NAME,
+		        PTR_ERR(rpi_cpufreq_cdev));
+		rpi_cpufreq_cdev = NULL;
+	}
+}
+
+static int rpi_cpufreq_exit(struct cpufreq_policy *policy)
+{
+	struct device *cpu_dev = get_cpu_device(policy->cpu);
+
+	cpufreq_cooling_unregister(rpi_cpufreq_cdev);
+	rpi_cpufreq_cdev = NULL;
+
+	dev_pm_opp_free_cpufreq_table(cpu_dev, &policy->freq_table);
+
+	return 0;
+}
+
+static struct cpufreq_driver rpi_cpufreq_driver = {
+	.name = DRIVER_NAME,
+	.flags = CPUFREQ_NEED_INITIAL_FREQ_CHECK,
+	.verify = cpufreq_generic_frequency_table_verify,
+	.target_index = rpi_cpufreq_target_index,
+	.get = rpi_cpufreq_get,
+	.init = rpi_cpufreq_init,
+	.ready = rpi_cpufreq_ready,
+	.exit = rpi_cpufreq_exit,
+	.attr = cpufreq_generic_attr,
+};
+
+static int rpi_cpufreq_add_opps(struct device *dev, struct device *cpu_dev)
+{
+	u32 min = 0, max = 0;
+	unsigned long rate;
+	int ret;
+
+	ret = rpi_cpufreq_clk_property(RPI_MBOX_TAG_GET_MIN_CLOCK_RATE, &min);
+	if (ret)
+		return ret;
+	ret = rpi_cpufreq_clk_property(RPI_MBOX_TAG_GET_MAX_CLOCK_RATE, &max);
+	if (ret)
+		return ret;
+
+	dev_info(dev, "ARM clock range %u-%u MHz\n", min / HZ_PER_MHZ, max / HZ_PER_MHZ);
+
+	for (rate = min; rate < max; rate += RPI_CPUFREQ_STEP_HZ) {
+		ret = dev_pm_opp_add(cpu_dev, rate, 0);
+		if (ret)
+			goto err;
+	}
+
+	ret = dev_pm_opp_add(cpu_dev, max, 0);
+	if (ret)
+		goto err;
+
+	ret = dev_pm_opp_set_sharing_cpus(cpu_dev, cpu_possible_mask);
+	if (ret)
+		goto err;
+
+	return 0;
+
+err:
+	dev_pm_opp_remove_all_dynamic(cpu_dev);
+	return ret;
+}
+
+static int rpi_cpufreq_probe(struct platform_device *pdev)
+{
+	struct device *cpu_dev;
+	int ret;
+
+	cpu_dev = get_cpu_device(0);
+	if (!cpu_dev)
+		return -ENODEV;
+
+	rpi_cpufreq_fw = rpi_mbox_firmware_get(&pdev->dev);
+	if (IS_ERR(rpi_cpufreq_fw))
+		return dev_err_probe(&pdev->dev, PTR_ERR(rpi_cpufreq_fw),
+		                     "Failed to get firmware interface\n");
+
+	ret = rpi_cpufreq_add_opps(&pdev->dev, cpu_dev);
+	if (ret)
+		return dev_err_probe(&pdev->dev, ret, "Failed to build OPP table\n");
+
+	ret = cpufreq_register_driver(&rpi_cpufreq_driver);
+	if (ret) {
+		dev_pm_opp_remove_all_dynamic(cpu_dev);
+		return dev_err_probe(&pdev->dev, ret, "Failed to register cpufreq driver\n");
+	}
+
+	dev_info(&pdev->dev, "rpi-cpufreq device initialized successfully\n");
+	return 0;
+}
+
+static int rpi_cpufreq_remove(struct platform_device *pdev)
+{
+	cpufreq_unregister_driver(&rpi_cpufreq_driver);
+	dev_pm_opp_remove_all_dynamic(get_cpu_device(0));
+
+	return 0;
+}
+
+static struct platform_driver rpi_cpufreq_platdrv = {
+	.driver = {
+		.name = DRIVER_NAME,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+	},
+	.probe = rpi_cpufreq_probe,
+	.remove = rpi_cpufreq_remove,
+};
+
+module_platform_driver(rpi_cpufreq_platdrv);
+
+MODULE_ALIAS("platform:" DRIVER_NAME);
+MODULE_AUTHOR("Richard Jeans <rich@jeansy.org>");
+MODULE_DESCRIPTION("Raspberry Pi CPU frequency scaling over the ACPI mailbox");
+MODULE_LICENSE("GPL v2");
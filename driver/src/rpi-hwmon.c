@@ -0,0 +1,524 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * rpi-hwmon.c - Raspberry Pi firmware sensors over the ACPI mailbox
+ *
+ * Reads the SoC temperature, the core and SDRAM voltages and the measured
+ * clock rates that raspberrypi-hwmon and clk-raspberrypi provide on DT.
+ * All of them, together with the throttle state, are fetched in one
+ * multi-tag property transaction every update_interval by a delayed work,
+ * and every attribute is served from that snapshot.
+ *
+ * GET_THROTTLED reports the current conditions in bits 0-3 and whether
+ * they occurred since boot in bits 16-19. Changes of the current bits are
+ * signalled with sysfs_notify() on the matching attribute and a
+ * KOBJ_CHANGE uevent, and the time each condition was active is counted.
+ */
+
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/hwmon.h>
+#include <linux/hwmon-sysfs.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/kobject.h>
+#include "rpi-mailbox.h"
+
+#define DRIVER_NAME "rpi-hwmon"
+
+#define RPI_HWMON_UPDATE_INTERVAL_MS	1000
+#define RPI_HWMON_MIN_INTERVAL_MS	100
+
+/* GET_THROTTLED condition bits; the sticky copy is 16 bits higher */
+#define RPI_THROTTLED_UNDER_VOLTAGE	0
+#define RPI_THROTTLED_FREQ_CAPPED	1
+#define RPI_THROTTLED_THROTTLED		2
+#define RPI_THROTTLED_SOFT_TEMP_LIMIT	3
+#define RPI_THROTTLED_NUM		4
+#define RPI_THROTTLED_STICKY_SHIFT	16
+#define RPI_THROTTLED_CURRENT_MSK	GENMASK(RPI_THROTTLED_NUM - 1, 0)
+
+static const char * const rpi_throttled_names[RPI_THROTTLED_NUM] = {
+	"under_voltage", "freq_capped", "throttled", "soft_temp_limit",
+};
+
+/* Voltage ids of GET_VOLTAGE, reported as in0..in3 */
+#define RPI_HWMON_NUM_VOLTS	4
+
+/* Clock ids of GET_MEASURED_CLOCK_RATE, reported as freq1..freqN */
+static const struct {
+	u32 id;
+	const char *label;
+} rpi_hwmon_clocks[] = {
+	{ 3, "arm" },
+	{ 4, "core" },
+	{ 5, "v3d" },
+	{ 8, "sdram" },
+	{ 9, "pixel" },
+	{ 12, "emmc2" },
+};
+
+static const char * const rpi_hwmon_volt_labels[RPI_HWMON_NUM_VOLTS] = {
+	"core", "sdram_c", "sdram_p", "sdram_i",
+};
+
+/* Every tag used here takes an id and returns the id and one value */
+struct rpi_hwmon_tag {
+	struct rpi_mbox_tag_header hdr;
+	__le32 id;
+	__le32 val;
+};
+
+struct rpi_hwmon_throttled_tag {
+	struct rpi_mbox_tag_header hdr;
+	__le32 val;
+};
+
+struct rpi_hwmon_batch {
+	struct rpi_hwmon_throttled_tag throttled;
+	struct rpi_hwmon_tag temp;
+	struct rpi_hwmon_tag max_temp;
+	struct rpi_hwmon_tag volts[RPI_HWMON_NUM_VOLTS];
+	struct rpi_hwmon_tag clocks[ARRAY_SIZE(rpi_hwmon_clocks)];
+};
+
+struct rpi_hwmon {
+	struct device *dev;
+	struct device *hwmon;
+	struct rpi_mbox *fw;
+	struct delayed_work work;
+
+	struct mutex lock;
+	bool valid;
+	unsigned int update_interval_ms;
+	u64 transactions;
+
+	/* Throttle state and per-condition accounting */
+	u32 throttled;
+	u64 throttled_events[RPI_THROTTLED_NUM];
+	u64 throttled_ms[RPI_THROTTLED_NUM];
+	unsigned long throttled_since[RPI_THROTTLED_NUM];
+
+	/* Snapshot of the last transaction */
+	long temp;
+	long max_temp;
+	long volts[RPI_HWMON_NUM_VOLTS];	/* uV */
+	long clocks[ARRAY_SIZE(rpi_hwmon_clocks)];
+};
+
+static void rpi_hwmon_init_tag(struct rpi_hwmon_tag *tag, u32 tag_id, u32 id)
+{
+	tag->hdr.tag = cpu_to_le32(tag_id);
+	tag->hdr.buf_size = cpu_to_le32(2 * sizeof(u32));
+	tag->hdr.req_resp_size = 0;
+	tag->id = cpu_to_le32(id);
+	tag->val = 0;
+}
+
+/* A tag the firmware did not answer keeps its previous value */
+static void rpi_hwmon_read_tag(const struct rpi_hwmon_tag *tag, long *val)
+{
+	if (le32_to_cpu(tag->hdr.req_resp_size) & RPI_MBOX_TAG_RESPONSE)
+		*val = le32_to_cpu(tag->val);
+}
+
+/* Accounts and signals changes of the current throttle bits */
+static void rpi_hwmon_throttled_changed(struct rpi_hwmon *data, u32 old, u32 new)
+{
+	unsigned long changed = (old ^ new) & RPI_THROTTLED_CURRENT_MSK;
+	unsigned long now = jiffies;
+	char env[32];
+	char *envp[] = { env, NULL, NULL };
+	int bit;
+
+	lockdep_assert_held(&data->lock);
+
+	if (!changed)
+		return;
+
+	for_each_set_bit(bit, &changed, RPI_THROTTLED_NUM) {
+		if (new & BIT(bit)) {
+			data->throttled_since[bit] = now;
+			data->throttled_events[bit]++;
+			dev_warn(data->dev, "Firmware reports %s\n", rpi_throttled_names[bit]);
+		} else {
+			data->throttled_ms[bit] += jiffies_to_msecs(now - data->throttled_since[bit]);
+			dev_info(data->dev, "Firmware no longer reports %s\n", rpi_throttled_names[bit]);
+		}
+
+		sysfs_notify(&data->hwmon->kobj, NULL, rpi_throttled_names[bit]);
+	}
+
+	/*
+	 * hwmon_notify_event() would send a KOBJ_CHANGE of its own, so notify
+	 * in0_lcrit_alarm by hand and carry its EVENT in the single uevent.
+	 */
+	if (changed & BIT(RPI_THROTTLED_UNDER_VOLTAGE)) {
+		sysfs_notify(&data->hwmon->kobj, NULL, "in0_lcrit_alarm");
+		envp[1] = "EVENT=in0_lcrit_alarm";
+	}
+
+	snprintf(env, sizeof(env), "THROTTLED=0x%05x", new);
+	kobject_uevent_env(&data->hwmon->kobj, KOBJ_CHANGE, envp);
+}
+
+static int rpi_hwmon_update(struct rpi_hwmon *data)
+{
+	struct rpi_hwmon_batch *batch;
+	int i, ret;
+
+	batch = kzalloc(sizeof(*batch), GFP_KERNEL);
+	if (!batch)
+		return -ENOMEM;
+
+	/* A zero request value leaves the sticky bits set */
+	batch->throttled.hdr.tag = cpu_to_le32(RPI_MBOX_TAG_GET_THROTTLED);
+	batch->throttled.hdr.buf_size = cpu_to_le32(sizeof(u32));
+	rpi_hwmon_init_tag(&batch->temp, RPI_MBOX_TAG_GET_TEMPERATURE, 0);
+	rpi_hwmon_init_tag(&batch->max_temp, RPI_MBOX_TAG_GET_MAX_TEMPERATURE, 0);
+	for (i = 0; i < RPI_HWMON_NUM_VOLTS; i++)
+		rpi_hwmon_init_tag(&batch->volts[i], RPI_MBOX_TAG_GET_VOLTAGE, i + 1);
+	for (i = 0; i < ARRAY_SIZE(rpi_hwmon_clocks); i++)
+		rpi_hwmon_init_tag(&batch->clocks[i], RPI_MBOX_TAG_GET_MEASURED_CLOCK_RATE,
+		                   rpi_hwmon_clocks[i].id);
+
+	ret = rpi_mbox_property_list(data->fw, batch, sizeof(*batch));
+	if (ret) {
+		dev_err_ratelimited(data->dev, "Failed to read firmware sensors: %d\n", ret);
+		goto out;
+	}
+
+	mutex_lock(&data->lock);
+
+	data->transactions++;
+
+	if (le32_to_cpu(batch->throttled.hdr.req_resp_size) & RPI_MBOX_TAG_RESPONSE) {
+		u32 throttled = le32_to_cpu(batch->throttled.val);
+
+		rpi_hwmon_throttled_changed(data, data->throttled, throttled);
+		data->throttled = throttled;
+	}
+
+	rpi_hwmon_read_tag(&batch->temp, &data->temp);
+	rpi_hwmon_read_tag(&batch->max_temp, &data->max_temp);
+	for (i = 0; i < RPI_HWMON_NUM_VOLTS; i++)
+		rpi_hwmon_read_tag(&batch->volts[i], &data->volts[i]);
+	for (i = 0; i < ARRAY_SIZE(rpi_hwmon_clocks); i++)
+		rpi_hwmon_read_tag(&batch->clocks[i], &data->clocks[i]);
+
+	data->valid = true;
+
+	mutex_unlock(&data->lock);
+
+out:
+	kfree(batch);
+
+	return ret;
+}
+
+static void rpi_hwmon_work(struct work_struct *work)
+{
+	struct rpi_hwmon *data = container_of(to_delayed_work(work), struct rpi_hwmon, work);
+
+	rpi_hwmon_update(data);
+
+	queue_delayed_work(system_freezable_power_efficient_wq, &data->work,
+	                   msecs_to_jiffies(READ_ONCE(data->update_interval_ms)));
+}
+
+static umode_t rpi_hwmon_is_visible(const void *drvdata, enum hwmon_sensor_types type,
+                                    u32 attr, int channel)
+{
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval)
+		return 0644;
+
+	return 0444;
+}
+
+static int rpi_hwmon_read(struct device *dev, enum hwmon_sensor_types type,
+                          u32 attr, int channel, long *val)
+{
+	struct rpi_hwmon *data = dev_get_drvdata(dev);
+	int ret = 0;
+
+	if (type == hwmon_chip) {
+		*val = data->update_interval_ms;
+		return 0;
+	}
+
+	mutex_lock(&data->lock);
+
+	if (!data->valid) {
+		ret = -ENODATA;
+		goto out;
+	}
+
+	switch (type) {
+	case hwmon_temp:
+		*val = attr == hwmon_temp_input ? data->temp : data->max_temp;
+		break;
+	case hwmon_in:
+		if (attr == hwmon_in_lcrit_alarm)
+			*val = !!(data->throttled & BIT(RPI_THROTTLED_UNDER_VOLTAGE));
+		else
+			*val = data->volts[channel] / 1000;
+		break;
+	default:
+		ret = -EOPNOTSUPP;
+		break;
+	}
+
+out:
+	mutex_unlock(&data->lock);
+
+	return ret;
+}
+
+static int rpi_hwmon_read_string(struct device *dev, enum hwmon_sensor_types type,
+                                 u32 attr, int channel, const char **str)
+{
+	switch (type) {
+	case hwmon_temp:
+		*str = "soc";
+		return 0;
+	case hwmon_in:
+		*str = rpi_hwmon_volt_labels[channel];
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int rpi_hwmon_write(struct device *dev, enum hwmon_sensor_types type,
+                           u32 attr, int channel, long val)
+{
+	struct rpi_hwmon *data = dev_get_drvdata(dev);
+
+	if (type != hwmon_chip || attr != hwmon_chip_update_interval)
+		return -EOPNOTSUPP;
+
+	WRITE_ONCE(data->update_interval_ms, clamp_val(val, RPI_HWMON_MIN_INTERVAL_MS, INT_MAX));
+	mod_delayed_work(system_freezable_power_efficient_wq, &data->work,
+	                 msecs_to_jiffies(data->update_interval_ms));
+
+	return 0;
+}
+
+/* hwmon has no clock type; the rates follow the freqN_input convention (Hz) */
+static ssize_t freq_input_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct rpi_hwmon *data = dev_get_drvdata(dev);
+	int index = to_sensor_dev_attr(attr)->index;
+	long rate;
+	bool valid;
+
+	mutex_lock(&data->lock);
+	rate = data->clocks[index];
+	valid = data->valid;
+	mutex_unlock(&data->lock);
+
+	if (!valid)
+		return -ENODATA;
+
+	return sysfs_emit(buf, "%ld\n", rate);
+}
+
+static ssize_t freq_label_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%s\n", rpi_hwmon_clocks[to_sensor_dev_attr(attr)->index].label);
+}
+
+static ssize_t transactions_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct rpi_hwmon *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%llu\n", data->transactions);
+}
+
+static ssize_t throttled_raw_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct rpi_hwmon *data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "0x%05x\n", READ_ONCE(data->throttled));
+}
+
+/* Current state of one condition */
+static ssize_t throttled_bit_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct rpi_hwmon *data = dev_get_drvdata(dev);
+	int bit = to_sensor_dev_attr(attr)->index;
+
+	return sysfs_emit(buf, "%d\n", !!(READ_ONCE(data->throttled) & BIT(bit)));
+}
+
+/* Whether the condition occurred since boot */
+static ssize_t throttled_occurred_show(struct device *dev, struct device_attribute *attr,
+                                       char *buf)
+{
+	struct rpi_hwmon *data = dev_get_drvdata(dev);
+	int bit = to_sensor_dev_attr(attr)->index + RPI_THROTTLED_STICKY_SHIFT;
+
+	return sysfs_emit(buf, "%d\n", !!(READ_ONCE(data->throttled) & BIT(bit)));
+}
+
+/* Total time the condition was active, including the current period */
+static ssize_t throttled_time_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct rpi_hwmon *data = dev_get_drvdata(dev);
+	int bit = to_sensor_dev_attr(attr)->index;
+	u64 ms;
+
+	mutex_lock(&data->lock);
+	ms = data->throttled_ms[bit];
+	if (data->throttled & BIT(bit))
+		ms += jiffies_to_msecs(jiffies - data->throttled_since[bit]);
+	mutex_unlock(&data->lock);
+
+	return sysfs_emit(buf, "%llu\n", ms);
+}
+
+static ssize_t throttled_events_show(struct device *dev, struct device_attribute *attr,
+                                     char *buf)
+{
+	struct rpi_hwmon *data = dev_get_drvdata(dev);
+	int bit = to_sensor_dev_attr(attr)->index;
+
+	return sysfs_emit(buf, "%llu\n", READ_ONCE(data->throttled_events[bit]));
+}
+
+#define RPI_THROTTLED_ATTRS(_name, _bit)						\
+static SENSOR_DEVICE_ATTR(_name, 0444, throttled_bit_show, NULL, _bit);		\
+static SENSOR_DEVICE_ATTR(_name##_occurred, 0444, throttled_occurred_show, NULL, _bit); \
+static SENSOR_DEVICE_ATTR(_name##_time_ms, 0444, throttled_time_show, NULL, _bit);	\
+static SENSOR_DEVICE_ATTR(_name##_events, 0444, throttled_events_show, NULL, _bit)
+
+RPI_THROTTLED_ATTRS(under_voltage, RPI_THROTTLED_UNDER_VOLTAGE);
+RPI_THROTTLED_ATTRS(freq_capped, RPI_THROTTLED_FREQ_CAPPED);
+RPI_THROTTLED_ATTRS(throttled, RPI_THROTTLED_THROTTLED);
+RPI_THROTTLED_ATTRS(soft_temp_limit, RPI_THROTTLED_SOFT_TEMP_LIMIT);
+static DEVICE_ATTR_RO(throttled_raw);
+
+#define RPI_THROTTLED_ATTR_LIST(_name)				\
+	&sensor_dev_attr_##_name.dev_attr.attr,			\
+	&sensor_dev_attr_##_name##_occurred.dev_attr.attr,	\
+	&sensor_dev_attr_##_name##_time_ms.dev_attr.attr,	\
+	&sensor_dev_attr_##_name##_events.dev_attr.attr
+
+static SENSOR_DEVICE_ATTR_RO(freq1_input, freq_input, 0);
+static SENSOR_DEVICE_ATTR_RO(freq1_label, freq_label, 0);
+static SENSOR_DEVICE_ATTR_RO(freq2_input, freq_input, 1);
+static SENSOR_DEVICE_ATTR_RO(freq2_label, freq_label, 1);
+static SENSOR_DEVICE_ATTR_RO(freq3_input, freq_input, 2);
+static SENSOR_DEVICE_ATTR_RO(freq3_label, freq_label, 2);
+static SENSOR_DEVICE_ATTR_RO(freq4_input, freq_input, 3);
+static SENSOR_DEVICE_ATTR_RO(freq4_label, freq_label, 3);
+static SENSOR_DEVICE_ATTR_RO(freq5_input, freq_input, 4);
+static SENSOR_DEVICE_ATTR_RO(freq5_label, freq_label, 4);
+static SENSOR_DEVICE_ATTR_RO(freq6_input, freq_input, 5);
+static SENSOR_DEVICE_ATTR_RO(freq6_label, freq_label, 5);
+static DEVICE_ATTR_RO(transactions);
+
+static struct attribute *rpi_hwmon_attrs[] = {
+	&sensor_dev_attr_freq1_input.dev_attr.attr,
+	&sensor_dev_attr_freq1_label.dev_attr.attr,
+	&sensor_dev_attr_freq2_input.dev_attr.attr,
+	&sensor_dev_attr_freq2_label.dev_attr.attr,
+	&sensor_dev_attr_freq3_input.dev_attr.attr,
+	&sensor_dev_attr_freq3_label.dev_attr.attr,
+	&sensor_dev_attr_freq4_input.dev_attr.attr,
+	&sensor_dev_attr_freq4_label.dev_attr.attr,
+	&sensor_dev_attr_freq5_input.dev_attr.attr,
+	&sensor_dev_attr_freq5_label.dev_attr.attr,
+	&sensor_dev_attr_freq6_input.dev_attr.attr,
+	&sensor_dev_attr_freq6_label.dev_attr.attr,
+	&dev_attr_transactions.attr,
+	&dev_attr_throttled_raw.attr,
+	RPI_THROTTLED_ATTR_LIST(under_voltage),
+	RPI_THROTTLED_ATTR_LIST(freq_capped),
+	RPI_THROTTLED_ATTR_LIST(throttled),
+	RPI_THROTTLED_ATTR_LIST(soft_temp_limit),
+	NULL
+};
+ATTRIBUTE_GROUPS(rpi_hwmon);
+
+static const struct hwmon_channel_info * const rpi_hwmon_info[] = {
+	HWMON_CHANNEL_INFO(chip, HWMON_C_UPDATE_INTERVAL),
+	HWMON_CHANNEL_INFO(temp, HWMON_T_INPUT | HWMON_T_CRIT | HWMON_T_LABEL),
+	HWMON_CHANNEL_INFO(in,
+	                   HWMON_I_INPUT | HWMON_I_LABEL | HWMON_I_LCRIT_ALARM,
+	                   HWMON_I_INPUT | HWMON_I_LABEL,
+	                   HWMON_I_INPUT | HWMON_I_LABEL,
+	                   HWMON_I_INPUT | HWMON_I_LABEL),
+	NULL
+};
+
+static const struct hwmon_ops rpi_hwmon_ops = {
+	.is_visible = rpi_hwmon_is_visible,
+	.read = rpi_hwmon_read,
+	.read_string = rpi_hwmon_read_string,
+	.write = rpi_hwmon_write,
+};
+
+static const struct hwmon_chip_info rpi_hwmon_chip_info = {
+	.ops = &rpi_hwmon_ops,
+	.info = rpi_hwmon_info,
+};
+
+static void rpi_hwmon_cancel_work(void *work)
+{
+	cancel_delayed_work_sync(work);
+}
+
+static int rpi_hwmon_probe(struct platform_device *pdev)
+{
+	struct rpi_hwmon *data;
+	int ret;
+
+	data = devm_kzalloc(&pdev->dev, sizeof(*data), GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+
+	data->dev = &pdev->dev;
+	data->update_interval_ms = RPI_HWMON_UPDATE_INTERVAL_MS;
+	mutex_init(&data->lock);
+	INIT_DELAYED_WORK(&data->work, rpi_hwmon_work);
+
+	data->fw = rpi_mbox_firmware_get(&pdev->dev);
+	if (IS_ERR(data->fw))
+		return dev_err_probe(&pdev->dev, PTR_ERR(data->fw),
+		                     "Failed to get firmware interface\n");
+
+	platform_set_drvdata(pdev, data);
+
+	data->hwmon = devm_hwmon_device_register_with_info(&pdev->dev, "rpi_firmware", data,
+	                                                   &rpi_hwmon_chip_info,
+	                                                   rpi_hwmon_groups);
+	if (IS_ERR(data->hwmon))
+		return dev_err_probe(&pdev->dev, PTR_ERR(data->hwmon),
+		                     "Failed to register hwmon device\n");
+
+	/* Registered after the hwmon device, so cancelled before it goes away */
+	ret = devm_add_action(&pdev->dev, rpi_hwmon_cancel_work, &data->work);
+	if (ret)
+		return ret;
+
+	queue_delayed_work(system_freezable_power_efficient_wq, &data->work, 0);
+
+	dev_info(&pdev->dev, "rpi-hwmon device initialized successfully\n");
+	return 0;
+}
+
+static struct platform_driver rpi_hwmon_driver = {
+	.driver = {
+		.name = DRIVER_NAME,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+	},
+	.probe = rpi_hwmon_probe,
+};
+
+module_platform_driver(rpi_hwmon_driver);
+
+MODULE_ALIAS("platform:" DRIVER_NAME);
+MODULE_AUTHOR("Richard Jeans <rich@jeansy.org>");
+MODULE_DESCRIPTION("Raspberry Pi firmware sensors over the ACPI mailbox");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * rpi-mailbox-trace.h - Tracepoints for the ACPI mailbox and firmware
+ * property transactions
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rpi
+
+#if !defined(_RPI_MAILBOX_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _RPI_MAILBOX_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(rpi_mbox_send,
+	TP_PROTO(unsigned int chan, u32 msg),
+	TP_ARGS(chan, msg),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, chan)
+		__field(u32, msg)
+	),
+
+	TP_fast_assign(
+		__entry->chan = chan;
+		__entry->msg = msg;
+	),
+
+	TP_printk("chan=%u msg=0x%08x", __entry->chan, __entry->msg)
+);
+
+TRACE_EVENT(rpi_mbox_receive,
+	TP_PROTO(unsigned int chan, u32 msg),
+	TP_ARGS(chan, msg),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, chan)
+		__field(u32, msg)
+	),
+
+	TP_fast_assign(
+		__entry->chan = chan;
+		__entry->msg = msg;
+	),
+
+	TP_printk("chan=%u msg=0x%08x", __entry->chan, __entry->msg)
+);
+
+/* One firmware round trip; tag is the first tag in the list */
+TRACE_EVENT(rpi_mbox_property,
+	TP_PROTO(u32 tag, size_t size, int ret, u64 latency_ns),
+	TP_ARGS(tag, size, ret, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(u32, tag)
+		__field(size_t, size)
+		__field(int, ret)
+		__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->tag = tag;
+		__entry->size = size;
+		__entry->ret = ret;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("tag=0x%08x size=%zu ret=%d latency=%llu ns",
+	          __entry->tag, __entry->size, __entry->ret, __entry->latency_ns)
+);
+
+#endif /* _RPI_MAILBOX_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rpi-mailbox-trace
+#include <trace/define_trace.h>
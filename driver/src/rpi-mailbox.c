@@ -29,8 +29,16 @@
 #include <linux/delay.h>
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
+#include <linux/mutex.h>
+#include <linux/property.h>
+#include <linux/ktime.h>
+#include <linux/perf_event.h>
+#include <linux/atomic.h>
 #include "rpi-mailbox.h"
 
+#define CREATE_TRACE_POINTS
+#include "rpi-mailbox-trace.h"
+
 
 
 /* Mailboxes */
@@ -61,6 +69,21 @@
 
 #define BCM2835_MAX_CHANNELS     16
 
+/*
+ * Firmware property buffer. The mailbox driver owns the firmware channel
+ * and serialises every property transaction through this one buffer.
+ */
+#define RPI_MBOX_FW_BUF_SIZE	PAGE_SIZE
+#define RPI_MBOX_FW_TIMEOUT	HZ
+
+#define MBOX_MSG(chan, data28)	(((data28) & ~0xf) | ((chan) & 0xf))
+
+/* Firmware clients that have no ACPI node of their own */
+static const char * const rpi_mbox_children[] = {
+	"rpi-hwmon",
+	"rpi-cpufreq",
+};
+
 struct rpi_mbox {
     void __iomem *regs;
     struct mbox_controller controller;
@@ -69,24 +92,95 @@ struct rpi_mbox {
     struct completion tx_completions[BCM2835_MAX_CHANNELS];
     int irq;
     spinlock_t lock;
+
+    struct mbox_client fw_client;
+    struct mbox_chan *fw_chan;
+    struct mutex fw_lock;
+    struct completion fw_done;
+    u32 *fw_buf;
+    dma_addr_t fw_dma;
+    struct platform_device *children[ARRAY_SIZE(rpi_mbox_children)];
+
+    struct pmu pmu;
+    bool pmu_registered;
 };
 
+/*
+ * Event counters behind the perf PMU. They are global, so clients can
+ * count before the mailbox has probed and the PMU only has to read them.
+ */
+static atomic64_t rpi_mbox_counters[RPI_MBOX_EV_MAX];
+
+void rpi_mbox_count(enum rpi_mbox_event ev, u64 n)
+{
+	if (ev < RPI_MBOX_EV_MAX)
+		atomic64_add(n, &rpi_mbox_counters[ev]);
+}
+EXPORT_SYMBOL_GPL(rpi_mbox_count);
 
-struct rpi_mbox *rpi_mbox_global;
 
 #define RPI_MBOX_CHAN_FIRMWARE 8
 
-struct mbox_chan *rpi_mbox_request_firmware_channel(struct mbox_client *cl)
+static struct platform_driver rpi_mbox_driver;
+
+/* One of rpi_mbox_probe's children, named after its rpi_mbox_children entry */
+static bool rpi_mbox_is_child(struct device *dev)
 {
-	struct rpi_mbox *mbox = rpi_mbox_global;
-	struct mbox_chan *chan;
-	int ret;
+	return dev->parent && dev->parent->driver == &rpi_mbox_driver.driver &&
+	       match_string(rpi_mbox_children, ARRAY_SIZE(rpi_mbox_children),
+	                    dev_name(dev)) >= 0;
+}
 
-	if (!cl || !mbox) {
-		pr_err("rpi_mbox_request_firmware_channel: Invalid client or uninitialized mailbox\n");
+/*
+ * Finds the mailbox a client is wired to: its "mboxes" reference for ACPI
+ * clients, or its parent for the children registered below. Returns
+ * -EPROBE_DEFER until that mailbox has bound, and links the client to it
+ * so the client is unbound first. Any other client without "mboxes" gets
+ * -ENODEV rather than deferring forever.
+ */
+static struct rpi_mbox *rpi_mbox_lookup(struct device *dev)
+{
+	struct fwnode_handle *fwnode;
+	struct rpi_mbox *mbox = NULL;
+	struct device *mdev;
+
+	fwnode = fwnode_find_reference(dev_fwnode(dev), "mboxes", 0);
+	if (!IS_ERR(fwnode)) {
+		mdev = bus_find_device_by_fwnode(&platform_bus_type, fwnode);
+		fwnode_handle_put(fwnode);
+	} else if (rpi_mbox_is_child(dev)) {
+		mdev = get_device(dev->parent);
+	} else {
 		return ERR_PTR(-ENODEV);
 	}
 
+	if (!mdev)
+		return ERR_PTR(-EPROBE_DEFER);
+
+	if (mdev->driver == &rpi_mbox_driver.driver)
+		mbox = dev_get_drvdata(mdev);
+
+	if (!mbox || !mbox->fw_chan) {
+		put_device(mdev);
+		return ERR_PTR(-EPROBE_DEFER);
+	}
+
+	if (mdev != dev->parent &&
+	    !device_link_add(dev, mdev, DL_FLAG_AUTOREMOVE_CONSUMER)) {
+		put_device(mdev);
+		return ERR_PTR(-EINVAL);
+	}
+
+	put_device(mdev);
+	return mbox;
+}
+
+static struct mbox_chan *rpi_mbox_request_firmware_channel(struct rpi_mbox *mbox,
+                                                           struct mbox_client *cl)
+{
+	struct mbox_chan *chan;
+	int ret;
+
 	if (RPI_MBOX_CHAN_FIRMWARE >= mbox->controller.num_chans) {
 		pr_err("rpi_mbox_request_firmware_channel: Firmware channel index out of range\n");
 		return ERR_PTR(-EINVAL);
@@ -110,25 +204,29 @@ struct mbox_chan *rpi_mbox_request_firmware_channel(struct mbox_client *cl)
 
 	return chan;
 }
-EXPORT_SYMBOL_GPL(rpi_mbox_request_firmware_channel);
 
 
 
 struct mbox_chan *rpi_mbox_request_channel(struct mbox_client *cl)
 {
+	struct rpi_mbox *mbox;
 	struct mbox_chan *chan;
 	int i, ret;
 
-	if (!cl || !rpi_mbox_global) {
-		pr_err("rpi_mbox_request_channel: Invalid client or uninitialized mailbox\n");
-		return ERR_PTR(-ENODEV);
+	if (!cl || !cl->dev) {
+		pr_err("rpi_mbox_request_channel: Invalid client\n");
+		return ERR_PTR(-EINVAL);
 	}
 
-	for (i = 0; i < rpi_mbox_global->controller.num_chans; i++) {
+	mbox = rpi_mbox_lookup(cl->dev);
+	if (IS_ERR(mbox))
+		return ERR_CAST(mbox);
+
+	for (i = 0; i < mbox->controller.num_chans; i++) {
 		if (i == RPI_MBOX_CHAN_FIRMWARE)
 			continue;
 
-		chan = &rpi_mbox_global->chans[i];
+		chan = &mbox->chans[i];
 		if (!chan->cl) {
 			ret = mbox_bind_client(chan, cl);
 			if (ret) {
@@ -136,8 +234,8 @@ struct mbox_chan *rpi_mbox_request_channel(struct mbox_client *cl)
 				return ERR_PTR(ret);
 			}
 
-			init_completion(&rpi_mbox_global->tx_completions[i]);
-			chan->mbox = &rpi_mbox_global->controller;
+			init_completion(&mbox->tx_completions[i]);
+			chan->mbox = &mbox->controller;
 			return chan;
 		}
 	}
@@ -165,6 +263,126 @@ int rpi_mbox_free_channel(struct mbox_chan *chan)
 }
 EXPORT_SYMBOL_GPL(rpi_mbox_free_channel);
 
+static void rpi_mbox_fw_rx(struct mbox_client *cl, void *msg)
+{
+	struct rpi_mbox *mbox = container_of(cl, struct rpi_mbox, fw_client);
+
+	complete(&mbox->fw_done);
+}
+
+struct rpi_mbox *rpi_mbox_firmware_get(struct device *dev)
+{
+	return rpi_mbox_lookup(dev);
+}
+EXPORT_SYMBOL_GPL(rpi_mbox_firmware_get);
+
+/*
+ * Sends a list of property tags to the firmware in one transaction. The
+ * tags are copied in and the responses copied back over them.
+ */
+int rpi_mbox_property_list(struct rpi_mbox *mbox, void *data, size_t tag_size)
+{
+	size_t size = tag_size + 12;
+	ktime_t start = 0;
+	u32 msg;
+	int ret;
+
+	if (!mbox || !mbox->fw_chan)
+		return -ENODEV;
+
+	/* Header (size, code), tags and end tag */
+	if (tag_size & 3 || size > RPI_MBOX_FW_BUF_SIZE)
+		return -EINVAL;
+
+	mutex_lock(&mbox->fw_lock);
+
+	mbox->fw_buf[0] = cpu_to_le32(size);
+	mbox->fw_buf[1] = cpu_to_le32(RPI_MBOX_STATUS_REQUEST);
+	memcpy(&mbox->fw_buf[2], data, tag_size);
+	mbox->fw_buf[size / 4 - 1] = 0;
+
+	reinit_completion(&mbox->fw_done);
+
+	/* The message must not be sent before the buffer is visible */
+	wmb();
+
+	msg = MBOX_MSG(RPI_MBOX_CHAN_FIRMWARE, mbox->fw_dma);
+	if (trace_rpi_mbox_property_enabled())
+		start = ktime_get();
+	ret = mbox_send_message(mbox->fw_chan, &msg);
+	if (ret < 0) {
+		dev_err(mbox->dev, "Failed to send property message: %d\n", ret);
+		goto out;
+	}
+
+	rpi_mbox_count(RPI_MBOX_EV_FW_TRANSACTIONS, 1);
+	rpi_mbox_count(RPI_MBOX_EV_FW_BYTES, size);
+
+	if (!wait_for_completion_timeout(&mbox->fw_done, RPI_MBOX_FW_TIMEOUT)) {
+		rpi_mbox_count(RPI_MBOX_EV_FW_TIMEOUTS, 1);
+		dev_err(mbox->dev, "Timeout waiting for firmware response\n");
+		ret = -ETIMEDOUT;
+		goto out;
+	}
+
+	memcpy(data, &mbox->fw_buf[2], tag_size);
+
+	if (le32_to_cpu(mbox->fw_buf[1]) != RPI_MBOX_STATUS_SUCCESS) {
+		dev_err(mbox->dev, "Firmware rejected property request: 0x%08x\n",
+		        le32_to_cpu(mbox->fw_buf[1]));
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	/* Only timed while tracing; skipped if enabled mid-message */
+	if (start)
+		trace_rpi_mbox_property(le32_to_cpup(data), size, ret,
+		                        ktime_to_ns(ktime_sub(ktime_get(), start)));
+	mutex_unlock(&mbox->fw_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rpi_mbox_property_list);
+
+/*
+ * Sends a single property tag. data holds the request values on entry and
+ * the response values on return.
+ */
+int rpi_mbox_property(struct rpi_mbox *mbox, u32 tag, void *data, size_t buf_size)
+{
+	struct rpi_mbox_tag_header *hdr;
+	size_t size = sizeof(*hdr) + ALIGN(buf_size, 4);
+	void *buf;
+	int ret;
+
+	buf = kzalloc(size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	hdr = buf;
+	hdr->tag = cpu_to_le32(tag);
+	hdr->buf_size = cpu_to_le32(buf_size);
+	hdr->req_resp_size = 0;
+	memcpy(buf + sizeof(*hdr), data, buf_size);
+
+	ret = rpi_mbox_property_list(mbox, buf, size);
+	if (!ret && !(le32_to_cpu(hdr->req_resp_size) & RPI_MBOX_TAG_RESPONSE)) {
+		dev_err(mbox->dev, "Firmware did not acknowledge property tag 0x%08x\n", tag);
+		ret = -EIO;
+	}
+
+	if (!ret)
+		memcpy(data, buf + sizeof(*hdr), buf_size);
+
+	kfree(buf);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rpi_mbox_property);
+
 static int rpi_mbox_send_data(struct mbox_chan *chan, void *data)
 {
 	struct rpi_mbox *mbox = container_of(chan->mbox, struct rpi_mbox, controller);
@@ -175,6 +393,8 @@ static int rpi_mbox_send_data(struct mbox_chan *chan, void *data)
 		return -EINVAL;
 	}
 
+	trace_rpi_mbox_send(chan - mbox->chans, msg);
+
 	spin_lock(&mbox->lock);
 	writel(msg, mbox->regs + MAIL1_WRT);
 	spin_unlock(&mbox->lock);
@@ -191,6 +411,8 @@ static bool rpi_mbox_last_tx_done(struct mbox_chan *chan)
 	ret = !(readl(mbox->regs + MAIL1_STA) & ARM_MS_FULL);
 	spin_unlock(&mbox->lock);
 
+	rpi_mbox_count(RPI_MBOX_EV_POLL_SPINS, 1);
+
 	return ret;
 }
 
@@ -222,11 +444,15 @@ static irqreturn_t rpi_mbox_irq(int irq, void *dev_id)
 		return IRQ_NONE;
 	}
 
+	rpi_mbox_count(RPI_MBOX_EV_IRQS, 1);
+
 	// Process all pending messages
 	while (!(readl(mbox->regs + MAIL0_STA) & ARM_MS_EMPTY)) {
 		u32 msg = readl(mbox->regs + MAIL0_RD);
 		u32 chan_index = msg & 0xf;
 
+		trace_rpi_mbox_receive(chan_index, msg);
+
 		// Validate channel index
 		if (chan_index >= BCM2835_MAX_CHANNELS) {
 			dev_warn(dev, "rpi_mbox_irq: Invalid channel index %u in IRQ msg 0x%08X\n", chan_index, msg);
@@ -248,6 +474,168 @@ static irqreturn_t rpi_mbox_irq(int irq, void *dev_id)
 	return handled;
 }
 
+/*
+ * System-wide counting PMU over rpi_mbox_counters, for
+ * "perf stat -a -e rpi_mbox/fw_transactions/". No sampling, and per-task
+ * counting makes no sense for firmware traffic.
+ */
+static u64 rpi_mbox_pmu_read_counter(struct perf_event *event)
+{
+	return atomic64_read(&rpi_mbox_counters[event->hw.config]);
+}
+
+static int rpi_mbox_pmu_event_init(struct perf_event *event)
+{
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+		return -EINVAL;
+
+	if (event->cpu < 0)
+		return -EINVAL;
+
+	if (event->attr.config >= RPI_MBOX_EV_MAX)
+		return -EINVAL;
+
+	event->hw.config = event->attr.config;
+
+	return 0;
+}
+
+static void rpi_mbox_pmu_event_update(struct perf_event *event)
+{
+	u64 prev, now;
+
+	do {
+		prev = local64_read(&event->hw.prev_count);
+		now = rpi_mbox_pmu_read_counter(event);
+	} while (local64_cmpxchg(&event->hw.prev_count, prev, now) != prev);
+
+	local64_add(now - prev, &event->count);
+}
+
+static void rpi_mbox_pmu_event_start(struct perf_event *event, int flags)
+{
+	local64_set(&event->hw.prev_count, rpi_mbox_pmu_read_counter(event));
+	event->hw.state = 0;
+}
+
+static void rpi_mbox_pmu_event_stop(struct perf_event *event, int flags)
+{
+	if (event->hw.state & PERF_HES_STOPPED)
+		return;
+
+	rpi_mbox_pmu_event_update(event);
+	event->hw.state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int rpi_mbox_pmu_event_add(struct perf_event *event, int flags)
+{
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	if (flags & PERF_EF_START)
+		rpi_mbox_pmu_event_start(event, flags);
+
+	return 0;
+}
+
+static void rpi_mbox_pmu_event_del(struct perf_event *event, int flags)
+{
+	rpi_mbox_pmu_event_stop(event, PERF_EF_UPDATE);
+}
+
+#define RPI_MBOX_PMU_EVENT(_name, _id) \
+	PMU_EVENT_ATTR_STRING(_name, rpi_mbox_pmu_event_##_name, "config=" __stringify(_id))
+
+RPI_MBOX_PMU_EVENT(fw_transactions, 0);
+RPI_MBOX_PMU_EVENT(fw_bytes, 1);
+RPI_MBOX_PMU_EVENT(fw_timeouts, 2);
+RPI_MBOX_PMU_EVENT(irqs, 3);
+RPI_MBOX_PMU_EVENT(poll_spins, 4);
+RPI_MBOX_PMU_EVENT(pwm_writes, 5);
+RPI_MBOX_PMU_EVENT(pwm_suppressed, 6);
+RPI_MBOX_PMU_EVENT(temp_samples, 7);
+
+static struct attribute *rpi_mbox_pmu_events[] = {
+	&rpi_mbox_pmu_event_fw_transactions.attr.attr,
+	&rpi_mbox_pmu_event_fw_bytes.attr.attr,
+	&rpi_mbox_pmu_event_fw_timeouts.attr.attr,
+	&rpi_mbox_pmu_event_irqs.attr.attr,
+	&rpi_mbox_pmu_event_poll_spins.attr.attr,
+	&rpi_mbox_pmu_event_pwm_writes.attr.attr,
+	&rpi_mbox_pmu_event_pwm_suppressed.attr.attr,
+	&rpi_mbox_pmu_event_temp_samples.attr.attr,
+	NULL
+};
+
+static const struct attribute_group rpi_mbox_pmu_events_group = {
+	.name = "events",
+	.attrs = rpi_mbox_pmu_events,
+};
+
+PMU_FORMAT_ATTR(event, "config:0-7");
+
+static struct attribute *rpi_mbox_pmu_formats[] = {
+	&format_attr_event.attr,
+	NULL
+};
+
+static const struct attribute_group rpi_mbox_pmu_format_group = {
+	.name = "format",
+	.attrs = rpi_mbox_pmu_formats,
+};
+
+/* The counters are system-wide; tell perf to open each event once */
+static ssize_t cpumask_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return cpumap_print_to_pagebuf(true, buf, cpumask_of(0));
+}
+static DEVICE_ATTR_RO(cpumask);
+
+static struct attribute *rpi_mbox_pmu_cpumask_attrs[] = {
+	&dev_attr_cpumask.attr,
+	NULL
+};
+
+static const struct attribute_group rpi_mbox_pmu_cpumask_group = {
+	.attrs = rpi_mbox_pmu_cpumask_attrs,
+};
+
+static const struct attribute_group *rpi_mbox_pmu_groups[] = {
+	&rpi_mbox_pmu_events_group,
+	&rpi_mbox_pmu_format_group,
+	&rpi_mbox_pmu_cpumask_group,
+	NULL
+};
+
+static void rpi_mbox_pmu_register(struct rpi_mbox *mbox)
+{
+	int ret;
+
+	mbox->pmu = (struct pmu) {
+		.module = THIS_MODULE,
+		.task_ctx_nr = perf_invalid_context,
+		.attr_groups = rpi_mbox_pmu_groups,
+		.capabilities = PERF_PMU_CAP_NO_EXCLUDE,
+		.event_init = rpi_mbox_pmu_event_init,
+		.add = rpi_mbox_pmu_event_add,
+		.del = rpi_mbox_pmu_event_del,
+		.start = rpi_mbox_pmu_event_start,
+		.stop = rpi_mbox_pmu_event_stop,
+		.read = rpi_mbox_pmu_event_update,
+	};
+
+	/* Counting still works without the PMU, so this is not fatal */
+	ret = perf_pmu_register(&mbox->pmu, "rpi_mbox", -1);
+	if (ret) {
+		dev_warn(mbox->dev, "Failed to register perf PMU: %d\n", ret);
+		return;
+	}
+
+	mbox->pmu_registered = true;
+}
+
 static const struct mbox_chan_ops rpi_mbox_chan_ops = {
 	.send_data     = rpi_mbox_send_data,
 	.startup       = rpi_mbox_startup,
@@ -258,6 +646,7 @@ static const struct mbox_chan_ops rpi_mbox_chan_ops = {
 static int rpi_mbox_probe(struct platform_device *pdev)
 {
 	struct rpi_mbox *mbox;
+	struct mbox_chan *chan;
 	struct resource *res;
 	int ret;
 
@@ -280,22 +669,17 @@ static int rpi_mbox_probe(struct platform_device *pdev)
 	// Store the mailbox structure in the platform device's driver data
 	platform_set_drvdata(pdev, mbox);
 	mbox->dev = &pdev->dev;
-	rpi_mbox_global = mbox;
 
 	// Get the IRQ resource for the mailbox
 	mbox->irq = platform_get_irq(pdev, 0);
-	if (mbox->irq < 0) {
-		ret = dev_err_probe(&pdev->dev, mbox->irq, "Failed to get IRQ\n");
-		goto err_free_mbox;
-	}
+	if (mbox->irq < 0)
+		return dev_err_probe(&pdev->dev, mbox->irq, "Failed to get IRQ\n");
 
 	// Request the IRQ and associate it with the mailbox IRQ handler
 	ret = devm_request_irq(&pdev->dev, mbox->irq, rpi_mbox_irq,
 			       0, dev_name(&pdev->dev), mbox);
-	if (ret) {
-		dev_err_probe(&pdev->dev, ret, "Failed to request IRQ\n");
-		goto err_free_mbox;
-	}
+	if (ret)
+		return dev_err_probe(&pdev->dev, ret, "Failed to request IRQ\n");
 
 	// Get the memory resource for the mailbox registers
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -303,7 +687,7 @@ static int rpi_mbox_probe(struct platform_device *pdev)
 	if (IS_ERR(mbox->regs)) {
 		ret = PTR_ERR(mbox->regs);
 		dev_err(&pdev->dev, "Failed to map mailbox registers: %d\n", ret);
-		goto err_free_mbox;
+		return ret;
 	}
 
 	// Initialize the mailbox controller
@@ -318,17 +702,49 @@ static int rpi_mbox_probe(struct platform_device *pdev)
 	ret = devm_mbox_controller_register(&pdev->dev, &mbox->controller);
 	if (ret) {
 		dev_err(&pdev->dev, "Failed to register mailbox controller: %d\n", ret);
-		goto err_free_mbox;
+		return ret;
 	}
 
+	// Take the firmware channel for the property interface
+	mbox->fw_buf = dmam_alloc_coherent(&pdev->dev, RPI_MBOX_FW_BUF_SIZE,
+	                                   &mbox->fw_dma, GFP_KERNEL);
+	if (!mbox->fw_buf)
+		return -ENOMEM;
+
+	mutex_init(&mbox->fw_lock);
+	init_completion(&mbox->fw_done);
+	mbox->fw_client.dev = &pdev->dev;
+	mbox->fw_client.tx_block = true;
+	mbox->fw_client.rx_callback = rpi_mbox_fw_rx;
+
+	chan = rpi_mbox_request_firmware_channel(mbox, &mbox->fw_client);
+	if (IS_ERR(chan)) {
+		ret = PTR_ERR(chan);
+		dev_err(&pdev->dev, "Failed to take firmware channel: %d\n", ret);
+		return ret;
+	}
+	mbox->fw_chan = chan;
+
+	// Firmware clients that have no ACPI node of their own
+	for (int i = 0; i < ARRAY_SIZE(rpi_mbox_children); i++) {
+		struct platform_device *child;
+
+		child = platform_device_register_data(&pdev->dev, rpi_mbox_children[i],
+		                                      PLATFORM_DEVID_NONE, NULL, 0);
+		if (IS_ERR(child)) {
+			dev_warn(&pdev->dev, "Failed to register %s: %ld\n",
+			         rpi_mbox_children[i], PTR_ERR(child));
+			continue;
+		}
+		mbox->children[i] = child;
+	}
+
+	if (IS_ENABLED(CONFIG_PERF_EVENTS))
+		rpi_mbox_pmu_register(mbox);
+
 	// Log successful initialization
 	dev_info(&pdev->dev, "rpi-mailbox device initialized successfully\n");
 	return 0;
-
-err_free_mbox:
-	// Cleanup in case of any errors
-	devm_kfree(&pdev->dev, mbox);
-	return ret;
 }
 
 static int rpi_mbox_remove(struct platform_device *pdev)
@@ -339,8 +755,12 @@ static int rpi_mbox_remove(struct platform_device *pdev)
 	dev_info(&pdev->dev, "Removing rpi-mailbox device\n");
 
 	if (mbox) {
-		// Perform any necessary cleanup here
-		devm_kfree(&pdev->dev, mbox);
+		if (mbox->pmu_registered)
+			perf_pmu_unregister(&mbox->pmu);
+		for (int i = 0; i < ARRAY_SIZE(mbox->children); i++)
+			platform_device_unregister(mbox->children[i]);
+		if (mbox->fw_chan)
+			rpi_mbox_free_channel(mbox->fw_chan);
 	}
 
 	dev_info(&pdev->dev, "rpi-mailbox device removed successfully\n");
@@ -357,6 +777,7 @@ static struct platform_driver rpi_mbox_driver = {
 	.driver = {
 		.name = "rpi-mbox",
 		.acpi_match_table = rpi_mbox_acpi_ids,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = rpi_mbox_probe,
 	.remove = rpi_mbox_remove,
@@ -9,9 +9,60 @@
 extern "C" {
 #endif
 
+struct rpi_mbox;
+
+/* Firmware property interface (channel 8), owned by the mailbox driver */
+#define RPI_MBOX_STATUS_REQUEST		0x00000000
+#define RPI_MBOX_STATUS_SUCCESS		0x80000000
+#define RPI_MBOX_TAG_RESPONSE		BIT(31)
+
+#define RPI_MBOX_TAG_GET_CLOCK_RATE		0x00030002
+#define RPI_MBOX_TAG_GET_MAX_CLOCK_RATE		0x00030004
+#define RPI_MBOX_TAG_GET_MIN_CLOCK_RATE		0x00030007
+#define RPI_MBOX_TAG_SET_CLOCK_RATE		0x00038002
+#define RPI_MBOX_TAG_GET_VOLTAGE		0x00030003
+#define RPI_MBOX_TAG_GET_TEMPERATURE		0x00030006
+#define RPI_MBOX_TAG_GET_MAX_TEMPERATURE	0x0003000a
+#define RPI_MBOX_TAG_GET_THROTTLED		0x00030046
+#define RPI_MBOX_TAG_GET_MEASURED_CLOCK_RATE	0x00030047
+#define RPI_MBOX_TAG_GET_POE_HAT_VAL		0x00030049
+#define RPI_MBOX_TAG_SET_POE_HAT_VAL		0x00038049
+
+struct rpi_mbox_tag_header {
+	__le32 tag;
+	__le32 buf_size;
+	__le32 req_resp_size;
+};
+
 extern struct mbox_chan *rpi_mbox_request_channel(struct mbox_client *);
 extern int rpi_mbox_free_channel(struct mbox_chan *);
-extern struct mbox_chan *rpi_mbox_request_firmware_channel(struct mbox_client *);
+
+/*
+ * Counters exported through the "rpi_mbox" perf PMU. Clients outside the
+ * mailbox driver count their own events with rpi_mbox_count(), which is a
+ * no-op when the mailbox driver is not reachable from the caller.
+ */
+enum rpi_mbox_event {
+	RPI_MBOX_EV_FW_TRANSACTIONS,
+	RPI_MBOX_EV_FW_BYTES,
+	RPI_MBOX_EV_FW_TIMEOUTS,
+	RPI_MBOX_EV_IRQS,
+	RPI_MBOX_EV_POLL_SPINS,
+	RPI_MBOX_EV_PWM_WRITES,
+	RPI_MBOX_EV_PWM_SUPPRESSED,
+	RPI_MBOX_EV_TEMP_SAMPLES,
+	RPI_MBOX_EV_MAX,
+};
+
+#if IS_REACHABLE(CONFIG_RPI_MAILBOX_ACPI)
+extern void rpi_mbox_count(enum rpi_mbox_event, u64 n);
+#else
+static inline void rpi_mbox_count(enum rpi_mbox_event ev, u64 n) { }
+#endif
+
+extern struct rpi_mbox *rpi_mbox_firmware_get(struct device *);
+extern int rpi_mbox_property_list(struct rpi_mbox *, void *data, size_t tag_size);
+extern int rpi_mbox_property(struct rpi_mbox *, u32 tag, void *data, size_t buf_size);
 
 
 
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * rpi-pwm-fan-trace.h - Tracepoints for fan cooling state changes
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rpi
+
+#if !defined(_RPI_PWM_FAN_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _RPI_PWM_FAN_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(rpi_fan_set_state,
+	TP_PROTO(unsigned long old_state, unsigned long state, unsigned int pwm, int ret),
+	TP_ARGS(old_state, state, pwm, ret),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, old_state)
+		__field(unsigned long, state)
+		__field(unsigned int, pwm)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__entry->old_state = old_state;
+		__entry->state = state;
+		__entry->pwm = pwm;
+		__entry->ret = ret;
+	),
+
+	TP_printk("state=%lu->%lu pwm=%u ret=%d",
+	          __entry->old_state, __entry->state, __entry->pwm, __entry->ret)
+);
+
+#endif /* _RPI_PWM_FAN_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rpi-pwm-fan-trace
+#include <trace/define_trace.h>
@@ -19,31 +19,16 @@
 #include <linux/thermal.h>
 #include "rpi-pwm-fan.h"
 
+#define CREATE_TRACE_POINTS
+#include "rpi-pwm-fan-trace.h"
 
 
-#define MAX_PWM 255
 
 
 
 
 
 
-
-
-static int pwm_fan_power_on(struct pwm_fan_ctx *ctx)
-{
-	if (ctx->enabled)
-		return 0;
-
-	ctx->pwm_state.enabled = true;
-	int ret = pwm_apply_might_sleep(ctx->pwm, &ctx->pwm_state);
-	if (!ret)
-		ctx->enabled = true;
-
-	return ret;
-}
-
-
 static int pwm_fan_power_off(struct pwm_fan_ctx *ctx)
 {
 	if (!ctx->enabled)
@@ -65,19 +50,24 @@ static int  __set_pwm(struct pwm_fan_ctx *ctx, unsigned long pwm)
 	int ret = 0;
 
 	if (pwm > 0) {
-
-
+		/*
+		 * Duty and enable go out in one apply: enabling separately
+		 * would first send a disabled state, which the PoE PWM turns
+		 * into duty 0 and stops the fan at boot-pwm handover.
+		 */
 		period = state->period;
 		state->duty_cycle = DIV_ROUND_UP(pwm * (period - 1), MAX_PWM);
+		state->enabled = true;
 		ret = pwm_apply_might_sleep(ctx->pwm, state);
-		if (ret)
-			return ret;
-		ret = pwm_fan_power_on(ctx);
+		if (!ret)
+			ctx->enabled = true;
 	} else {
 		ret = pwm_fan_power_off(ctx);
 	}
-	if (!ret)
+	if (!ret) {
 		ctx->pwm_value = pwm;
+		ctx->applied = true;
+	}
 
 	return ret;
 }
@@ -104,6 +94,86 @@ static void pwm_fan_update_state(struct pwm_fan_ctx *ctx, unsigned long pwm)
 	ctx->pwm_fan_state = i;
 }
 
+/*
+ * The context behind a cooling device registered by this driver. The
+ * thermal core unbinds a cooling device from every zone before
+ * thermal_cooling_device_unregister() returns, so a zone that only calls
+ * in between its .bind and .unbind never sees a freed context.
+ */
+static struct pwm_fan_ctx *pwm_fan_cdev_ctx(struct thermal_cooling_device *cdev)
+{
+	struct acpi_device *adev = cdev ? cdev->devdata : NULL;
+
+	return adev ? adev->driver_data : NULL;
+}
+
+/*
+ * Set the fan duty directly rather than through a cooling state. Used by
+ * the RPIT0001 set-point controller.
+ */
+int rpi_pwm_fan_set_duty(struct thermal_cooling_device *cdev, unsigned long pwm)
+{
+	struct pwm_fan_ctx *ctx = pwm_fan_cdev_ctx(cdev);
+	int ret;
+
+	if (!ctx || pwm > MAX_PWM)
+		return -EINVAL;
+
+	ret = set_pwm(ctx, pwm);
+	if (ret)
+		return ret;
+
+	if (ctx->pwm_fan_cooling_levels)
+		pwm_fan_update_state(ctx, pwm);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(rpi_pwm_fan_set_duty);
+
+/*
+ * Minimum duty applied on top of the cooling state, so the thermal
+ * driver's load feed-forward can spin the fan up ahead of the governor.
+ * The cooling state itself is left as the governor set it.
+ */
+int rpi_pwm_fan_set_floor(struct thermal_cooling_device *cdev, unsigned long floor)
+{
+	struct pwm_fan_ctx *ctx = pwm_fan_cdev_ctx(cdev);
+	unsigned long pwm;
+	int ret = 0;
+
+	if (!ctx || floor > MAX_PWM)
+		return -EINVAL;
+
+	mutex_lock(&ctx->lock);
+	ctx->pwm_floor = floor;
+	if (ctx->pwm_fan_cooling_levels) {
+		pwm = max_t(unsigned long, floor,
+			    ctx->pwm_fan_cooling_levels[ctx->pwm_fan_state]);
+		if (pwm != ctx->pwm_value)
+			ret = __set_pwm(ctx, pwm);
+	}
+	mutex_unlock(&ctx->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rpi_pwm_fan_set_floor);
+
+/* Cooling state and duty last applied, for the thermal driver's history */
+int rpi_pwm_fan_get_status(struct thermal_cooling_device *cdev, unsigned int *state,
+			   unsigned int *duty)
+{
+	struct pwm_fan_ctx *ctx = pwm_fan_cdev_ctx(cdev);
+
+	if (!ctx)
+		return -EINVAL;
+
+	*state = READ_ONCE(ctx->pwm_fan_state);
+	*duty = READ_ONCE(ctx->pwm_value);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(rpi_pwm_fan_get_status);
+
 
 static int pwm_fan_write(struct device *dev, enum hwmon_sensor_types type,
 			 u32 attr, int channel, long val)
@@ -211,6 +281,7 @@ static int
 pwm_fan_set_cur_state(struct thermal_cooling_device *cdev, unsigned long state)
 {
 	struct pwm_fan_ctx *ctx = NULL;
+	unsigned int pwm;
 	int ret;
 	struct acpi_device *adev = cdev->devdata;
 	if (adev->driver_data)
@@ -222,7 +293,9 @@ pwm_fan_set_cur_state(struct thermal_cooling_device *cdev, unsigned long state)
 	if (state == ctx->pwm_fan_state)
 		return 0;
 
-	ret = set_pwm(ctx, ctx->pwm_fan_cooling_levels[state]);
+	pwm = max(ctx->pwm_fan_cooling_levels[state], READ_ONCE(ctx->pwm_floor));
+	ret = set_pwm(ctx, pwm);
+	trace_rpi_fan_set_state(ctx->pwm_fan_state, state, pwm, ret);
 	if (ret) {
 		dev_err(&cdev->device, "Cannot set pwm!\n");
 		return ret;
@@ -284,11 +357,35 @@ static int pwm_fan_get_cooling_data(struct device *dev,
 	return 0;
 }
 
+/*
+ * Applies the starting duty after probe, so the PWM's firmware round trip
+ * stays off the probe path. Anything set in the meantime wins.
+ */
+static void pwm_fan_init_work(struct work_struct *work)
+{
+	struct pwm_fan_ctx *ctx = container_of(work, struct pwm_fan_ctx, init_work);
+	int ret = 0;
+
+	mutex_lock(&ctx->lock);
+	if (!ctx->applied)
+		ret = __set_pwm(ctx, ctx->pwm_value);
+	mutex_unlock(&ctx->lock);
+
+	if (ret)
+		dev_err(ctx->dev, "Failed to configure PWM: %d\n", ret);
+}
+
+/* Probe failure or unbind: the ACPI companion outlives the context */
+static void pwm_fan_clear_adev(void *adev)
+{
+	((struct acpi_device *)adev)->driver_data = NULL;
+}
+
 static void pwm_fan_cleanup(void *__ctx)
 {
 	struct pwm_fan_ctx *ctx = __ctx;
 
-
+	cancel_work_sync(&ctx->init_work);
 
 	pwm_fan_power_off(ctx);
 }
@@ -303,6 +400,7 @@ static int pwm_fan_probe(struct platform_device *pdev)
 	};
 	struct thermal_cooling_device *cdev;
 	struct device *hwmon;
+	u32 boot_pwm;
 	int ret;
 	struct acpi_device *adev = ACPI_COMPANION(&pdev->dev);
 
@@ -318,6 +416,7 @@ static int pwm_fan_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	mutex_init(&ctx->lock);
+	INIT_WORK(&ctx->init_work, pwm_fan_init_work);
 	ctx->dev = dev;
 
 	ctx->pwm = devm_pwm_get(dev, NULL);
@@ -327,6 +426,10 @@ static int pwm_fan_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, ctx);
     adev->driver_data = ctx;
 
+	ret = devm_add_action_or_reset(dev, pwm_fan_clear_adev, adev);
+	if (ret)
+		return ret;
+
 
 	pwm_init_state(ctx->pwm, &ctx->pwm_state);
 	ctx->pwm_state.usage_power = true;
@@ -337,16 +440,18 @@ static int pwm_fan_probe(struct platform_device *pdev)
 	}
 
 
-	ret = set_pwm(ctx, MAX_PWM);
-	if (ret) {
-		dev_err(dev, "Failed to configure PWM: %d\n", ret);
-		return ret;
-	}
+	/* Carry on from the duty UEFI left the fan at, if it handed one over */
+	if (device_property_read_u32(dev, "boot-pwm", &boot_pwm) || boot_pwm > MAX_PWM)
+		boot_pwm = MAX_PWM;
+
+	ctx->pwm_value = boot_pwm;
 
 	ret = devm_add_action_or_reset(dev, pwm_fan_cleanup, ctx);
 	if (ret)
 		return ret;
 
+	schedule_work(&ctx->init_work);
+
 
 	ctx->info.ops = &pwm_fan_hwmon_ops;
 	ctx->info.info = ctx_channels;
@@ -363,7 +468,7 @@ static int pwm_fan_probe(struct platform_device *pdev)
 		return ret;
 	}
 
-	ctx->pwm_fan_state = ctx->pwm_fan_max_state;
+	pwm_fan_update_state(ctx, ctx->pwm_value);
 
 	if (IS_ENABLED(CONFIG_THERMAL)) {
          cdev = thermal_cooling_device_register( "pwm-fan", adev,
@@ -435,32 +540,12 @@ MODULE_DEVICE_TABLE(acpi, acpi_pwm_fan_match);
 static int pwm_fan_remove(struct platform_device *pdev)
 {
 	struct pwm_fan_ctx *ctx = platform_get_drvdata(pdev);
-	int i;
 
 	if (!ctx)
 		return -EINVAL;
 
 	if (ctx->cdev) {
-		/* Unbind from stored thermal zone if available */
-		if (ctx->tz) {
-			dev_info(ctx->dev,
-			         "Unbinding cooling device from thermal zone: %s\n",
-			         dev_name(&ctx->tz->device));
-
-			for (i = 0; i < ctx->tz->num_trips; i++) {
-				int ret = thermal_zone_unbind_cooling_device(ctx->tz, i, ctx->cdev);
-				if (ret)
-					dev_warn(ctx->dev,
-					         "Failed to unbind from trip %d: %d\n", i, ret);
-				else
-					dev_info(ctx->dev,
-					         "Unbound cooling device from trip %d\n", i);
-			}
-		} else {
-			dev_warn(ctx->dev,
-			         "No thermal zone recorded, skipping unbind\n");
-		}
-
+		/* Unregistering unbinds the cooling device from every zone */
 		sysfs_remove_link(&ctx->cdev->device.kobj, "device");
 		sysfs_remove_link(&ctx->dev->kobj, "thermal_cooling");
 		thermal_cooling_device_unregister(ctx->cdev);
@@ -479,6 +564,7 @@ static struct platform_driver pwm_fan_driver = {
 		.name		= "pwm-fan",
 		.pm		= pm_sleep_ptr(&pwm_fan_pm),
 		.acpi_match_table	= acpi_pwm_fan_match,
+		.probe_type	= PROBE_PREFER_ASYNCHRONOUS,
 	},
 };
 
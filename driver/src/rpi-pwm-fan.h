@@ -7,6 +7,9 @@
 #include <linux/pwm.h>
 #include <linux/thermal.h>
 #include <linux/hwmon.h>
+#include <linux/workqueue.h>
+
+#define MAX_PWM 255
 
 struct pwm_fan_ctx {
 	struct device *dev;
@@ -15,16 +18,22 @@ struct pwm_fan_ctx {
 	struct pwm_device *pwm;
 	struct pwm_state pwm_state;
 	bool enabled;
+	bool applied;		/* a duty has reached the PWM since probe */
+	struct work_struct init_work;
 
 	unsigned int pwm_value;
+	unsigned int pwm_floor;
 	unsigned int pwm_fan_state;
 	unsigned int pwm_fan_max_state;
 	unsigned int *pwm_fan_cooling_levels;
 	struct thermal_cooling_device *cdev;
 
-    struct thermal_zone_device * tz;
-
 	struct hwmon_chip_info info;
 };
 
+int rpi_pwm_fan_set_duty(struct thermal_cooling_device *cdev, unsigned long pwm);
+int rpi_pwm_fan_set_floor(struct thermal_cooling_device *cdev, unsigned long floor);
+int rpi_pwm_fan_get_status(struct thermal_cooling_device *cdev, unsigned int *state,
+			   unsigned int *duty);
+
 #endif // RPI_PWM_FAN_H
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * rpi-pwm-poe-trace.h - Tracepoints for PoE HAT PWM writes
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rpi
+
+#if !defined(_RPI_PWM_POE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _RPI_PWM_POE_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(rpi_poe_fw_msg,
+	TP_PROTO(u32 tag, u32 reg, u32 value, int ret, u64 latency_ns),
+	TP_ARGS(tag, reg, value, ret, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(u32, tag)
+		__field(u32, reg)
+		__field(u32, value)
+		__field(int, ret)
+		__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->tag = tag;
+		__entry->reg = reg;
+		__entry->value = value;
+		__entry->ret = ret;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("tag=0x%08x reg=0x%x value=%u ret=%d latency=%llu ns",
+	          __entry->tag, __entry->reg, __entry->value, __entry->ret,
+	          __entry->latency_ns)
+);
+
+/* skipped is set when the duty was unchanged and nothing was sent */
+TRACE_EVENT(rpi_pwm_poe_apply,
+	TP_PROTO(u64 duty_ns, bool enabled, unsigned int old_duty,
+	         unsigned int new_duty, bool skipped),
+	TP_ARGS(duty_ns, enabled, old_duty, new_duty, skipped),
+
+	TP_STRUCT__entry(
+		__field(u64, duty_ns)
+		__field(bool, enabled)
+		__field(unsigned int, old_duty)
+		__field(unsigned int, new_duty)
+		__field(bool, skipped)
+	),
+
+	TP_fast_assign(
+		__entry->duty_ns = duty_ns;
+		__entry->enabled = enabled;
+		__entry->old_duty = old_duty;
+		__entry->new_duty = new_duty;
+		__entry->skipped = skipped;
+	),
+
+	TP_printk("duty_ns=%llu enabled=%d duty=%d->%u%s",
+	          __entry->duty_ns, __entry->enabled, (int)__entry->old_duty,
+	          __entry->new_duty, __entry->skipped ? " skipped" : "")
+);
+
+#endif /* _RPI_PWM_POE_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rpi-pwm-poe-trace
+#include <trace/define_trace.h>
@@ -7,26 +7,20 @@
 #include <linux/mailbox_client.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
+#include <linux/ktime.h>
 #include "rpi-mailbox.h"
 
-static DEFINE_MUTEX(transaction_lock);
-
-
-
-
-#define RPI_MBOX_CHAN_FIRMWARE       8
+#define CREATE_TRACE_POINTS
+#include "rpi-pwm-poe-trace.h"
 
 #define RPI_PWM_MAX_DUTY		255
+#define RPI_PWM_DUTY_UNKNOWN		UINT_MAX
 #define RPI_PWM_PERIOD_NS		80000 /* 12.5 kHz */
 
-#define MBOX_MSG(chan, data28)		(((data28) & ~0xf) | ((chan) & 0xf))
-
 struct acpi_pwm_driver_data {
 	struct pwm_chip chip;
-	struct mbox_client mbox;
-	struct mbox_chan *chan;
+	struct rpi_mbox *fw;
 	struct device *dev;
-    struct completion c;
 	unsigned int scaled_duty_cycle;
     struct pwm_state state;
 };
@@ -36,117 +30,49 @@ static inline struct acpi_pwm_driver_data *to_acpi_pwm(struct pwm_chip *chip)
 	return container_of(chip, struct acpi_pwm_driver_data, chip);
 }
 
-static void response_callback(struct mbox_client *cl, void *msg)
-{
-	struct acpi_pwm_driver_data *data = container_of(cl, struct acpi_pwm_driver_data, mbox);
-	complete(&data->c);
-}
-
-
-#define RPI_FIRMWARE_GET_POE_HAT_VAL    0x00030049
-#define RPI_FIRMWARE_SET_POE_HAT_VAL    0x00038049
-#define RPI_FIRMWARE_STATUS_REQUEST 0x00000000
-
 #define RPI_PWM_CUR_DUTY_REG         0x0
 #define RPI_PWM_CUR_ENABLE_REG         0x0
 
-#
-// Sub-registers used inside the payload
-
-
-static int build_poe_firmware_msg(u32 *buf,
-                                  bool is_get,
-                                  u32 property_tag,
-                                  u32 reg,
-                                  u32 value)
-{
-	if (!buf)
-		return -EINVAL;
-
-	buf[0] = cpu_to_le32(9 * sizeof(u32));      // total size: 32 bytes
-	buf[1] = cpu_to_le32(RPI_FIRMWARE_STATUS_REQUEST);           // request
-	buf[2] = cpu_to_le32(property_tag);   // compound PoE property tag
-	buf[3] = cpu_to_le32(3*sizeof(u32));                    // tag payload size
-	buf[4] = cpu_to_le32(0);       // 0 for GET, 0 for SET
-	buf[5] = cpu_to_le32(reg);               // register to read or write
-	buf[6] = cpu_to_le32(value);                // value (unused for GET)
-	buf[7] = cpu_to_le32(0);                    
-	buf[8] = cpu_to_le32(0);                    
-
-	return 0;
-}
+// Payload of the PoE HAT property tags
+struct rpi_poe_msg {
+	__le32 reg;	// register to read or write
+	__le32 val;	// value (unused for GET)
+	__le32 ret;
+};
 
-static int send_mbox_message(struct completion *c, struct device *dev, struct mbox_chan *chan,
-                             u32 property_tag, u32 reg, u32 value, bool is_get, u32 *value_out)
+static int send_mbox_message(struct device *dev, struct rpi_mbox *fw,
+                             u32 property_tag, u32 reg, u32 value, u32 *value_out)
 {
-    dma_addr_t dma_handle;
-    u32 *dma_buf;
-    int ret;
-
- 
-    dma_buf = dma_alloc_coherent(chan->mbox->dev, PAGE_ALIGN(9 * sizeof(u32)), &dma_handle, GFP_ATOMIC);
-    if (!dma_buf) {
-        dev_err(dev, "send_mbox_message: Failed to allocate DMA buffer\n");
-        return -ENOMEM;
-    }
-
-    ret = build_poe_firmware_msg(dma_buf, is_get, property_tag, reg, value);
-
-    
-
-    dev_dbg(dev, "Sending tag 0x%08x reg 0x%08x val %u\n", dma_buf[2], dma_buf[5], dma_buf[6]);
-
-
-    mutex_lock(&transaction_lock);
-
-    reinit_completion(c);
-
-    u32 msg = MBOX_MSG(RPI_MBOX_CHAN_FIRMWARE, dma_handle);
-
-
-    ret = mbox_send_message(chan, &msg);
-    if (ret < 0) {
-        dev_err(dev, "send_mbox_message: Failed to send message: %pe\n", ERR_PTR(ret));
-        goto out_free;
-    }
-
-    if (!wait_for_completion_timeout(c, HZ)) {
-        dev_err(dev, "Timeout waiting for response\n");
-        ret = -ETIMEDOUT;
-        goto out_free;
-    }
-
-    if (!(dma_buf[4] & 0x80000000)) {
-        dev_err(dev, "Firmware did not acknowledge property tag 0x%08x\n", property_tag);
-        ret = -EIO;
-        goto out_free;
-    }
-
-    if (is_get && value_out)
-        *value_out = le32_to_cpu(dma_buf[6]);
+	struct rpi_poe_msg msg = {
+		.reg = cpu_to_le32(reg),
+		.val = cpu_to_le32(value),
+	};
+	ktime_t start = 0;
+	int ret;
 
-    ret = 0;
+	dev_dbg(dev, "Sending tag 0x%08x reg 0x%08x val %u\n", property_tag, reg, value);
 
-out_free:
-	mutex_unlock(&transaction_lock);
-	dma_free_coherent(chan->mbox->dev, PAGE_ALIGN(7 * sizeof(u32)), dma_buf, dma_handle);
+	if (trace_rpi_poe_fw_msg_enabled())
+		start = ktime_get();
+	ret = rpi_mbox_property(fw, property_tag, &msg, sizeof(msg));
+	if (start)
+		trace_rpi_poe_fw_msg(property_tag, reg, value, ret,
+		                     ktime_to_ns(ktime_sub(ktime_get(), start)));
+	if (ret)
+		return ret;
 
-	return ret;
-}
+	if (value_out)
+		*value_out = le32_to_cpu(msg.val);
 
-static int send_pwm_duty(struct completion *c, struct device *dev, struct mbox_chan *chan, u8 duty)
-{
-    return send_mbox_message(c, dev, chan, RPI_FIRMWARE_SET_POE_HAT_VAL, RPI_PWM_CUR_DUTY_REG, duty, false, NULL);
+	return 0;
 }
 
-
-static int get_pwm_duty(struct completion *c, struct device *dev, struct mbox_chan *chan, u32 *value_out)
+static int send_pwm_duty(struct device *dev, struct rpi_mbox *fw, u8 duty)
 {
-    return send_mbox_message(c, dev, chan, RPI_FIRMWARE_GET_POE_HAT_VAL, RPI_PWM_CUR_DUTY_REG,0, true, value_out);
+    return send_mbox_message(dev, fw, RPI_MBOX_TAG_SET_POE_HAT_VAL, RPI_PWM_CUR_DUTY_REG, duty, NULL);
 }
 
 
-
 static int rpi_pwm_poe_apply(struct pwm_chip *chip, struct pwm_device *pwm,
                              const struct pwm_state *state)
 {
@@ -170,13 +96,20 @@ static int rpi_pwm_poe_apply(struct pwm_chip *chip, struct pwm_device *pwm,
 		new_scaled_duty_cycle = RPI_PWM_MAX_DUTY;
 	}
 
+	trace_rpi_pwm_poe_apply(state->duty_cycle, state->enabled, data->scaled_duty_cycle,
+	                        new_scaled_duty_cycle,
+	                        new_scaled_duty_cycle == data->scaled_duty_cycle);
+
 	// Skip updating if the duty cycle hasn't changed
 	if (new_scaled_duty_cycle == data->scaled_duty_cycle) {
+		rpi_mbox_count(RPI_MBOX_EV_PWM_SUPPRESSED, 1);
 		return 0;
 	}
 
+	rpi_mbox_count(RPI_MBOX_EV_PWM_WRITES, 1);
+
 	// Send the new duty cycle to the firmware
-	ret = send_pwm_duty(&data->c, data->dev, data->chan, new_scaled_duty_cycle);
+	ret = send_pwm_duty(data->dev, data->fw, new_scaled_duty_cycle);
 	if (ret) {
 		return ret;
 	}
@@ -243,7 +176,6 @@ static const struct pwm_ops rpi_pwm_poe_ops = {
 static int rpi_pwm_poe_probe(struct platform_device *pdev)
 {
 	struct acpi_pwm_driver_data *data;
-	struct mbox_client *cl;
 	int ret;
 
 	// Check if CONFIG_PWM is enabled
@@ -263,26 +195,15 @@ static int rpi_pwm_poe_probe(struct platform_device *pdev)
 	}
 
 	data->dev = &pdev->dev;
-	cl = &data->mbox;
-	cl->dev = &pdev->dev;
-	cl->tx_block = true;
-	cl->rx_callback = response_callback;
-
-	init_completion(&data->c);
-
-	// Request the firmware mailbox channel
-	data->chan = rpi_mbox_request_firmware_channel(cl);
-	if (IS_ERR(data->chan)) {
-		ret = PTR_ERR(data->chan);
-		dev_err(&pdev->dev, "Failed to request firmware mailbox channel: %d\n", ret);
-		return ret;
-	}
 
-	// Get the current duty cycle from the firmware
-	ret = get_pwm_duty(&data->c, &pdev->dev, data->chan, &data->scaled_duty_cycle);
-	if (ret < 0) {
-		dev_warn(&pdev->dev, "Failed to get current duty cycle: %d\n", ret);
-	}
+	// Look up the firmware property interface, deferring until it is up
+	data->fw = rpi_mbox_firmware_get(&pdev->dev);
+	if (IS_ERR(data->fw))
+		return dev_err_probe(&pdev->dev, PTR_ERR(data->fw),
+		                     "Failed to get firmware interface\n");
+
+	// Not read back at probe: the first apply always reaches the firmware
+	data->scaled_duty_cycle = RPI_PWM_DUTY_UNKNOWN;
 
 	// Initialize the PWM state
 	data->state.period = RPI_PWM_PERIOD_NS;
@@ -301,7 +222,6 @@ static int rpi_pwm_poe_probe(struct platform_device *pdev)
 	ret = devm_pwmchip_add(&pdev->dev, &data->chip);
 	if (ret) {
 		dev_err(&pdev->dev, "Failed to register PWM chip: %d\n", ret);
-		rpi_mbox_free_channel(data->chan);
 		return ret;
 	}
 
@@ -318,17 +238,12 @@ static int rpi_pwm_poe_remove(struct platform_device *pdev)
 	dev_info(&pdev->dev, "Removing rpi-pwm-poe device\n");
 
 	// Reset the duty cycle to 0
-	ret = send_pwm_duty(&data->c, data->dev, data->chan, 0);
+	ret = send_pwm_duty(data->dev, data->fw, 0);
 	if (ret) {
 		dev_warn(data->dev, "Failed to send PWM duty: %d\n", ret);
 		return ret;
 	}
 
-	// Free the mailbox channel
-	if (data->chan) {
-		rpi_mbox_free_channel(data->chan);
-	}
-
 	return 0;
 }
 
@@ -342,6 +257,7 @@ static struct platform_driver rpi_pwm_poe_driver = {
 	.driver = {
 		.name = "rpi-pwm-poe",
 		.acpi_match_table = rpi_pwm_poe_ids,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = rpi_pwm_poe_probe,
 	.remove = rpi_pwm_poe_remove,
@@ -0,0 +1,407 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * pwm-fan-latency - Latency of hwmon pwm1 under concurrent load
+ *
+ * Drives /sys/class/hwmon/hwmonN/pwm1 of the pwm-fan device ("pwmfan")
+ * from writer and reader threads while thermal threads read the
+ * RPIT0001 zone temperature and step the fan's cooling state, so writes
+ * contend with the thermal core on the fan lock and the PoE firmware
+ * round trip. Reports p50/p99/max latency and throughput per operation
+ * as TAP, and restores pwm1 and the cooling state on exit.
+ *
+ * Needs root and a bound pwm-fan; skips otherwise.
+ *
+ * Usage: pwm-fan-latency [-d seconds] [-w writers] [-r readers] [-t thermal]
+ *                        [-h hwmon dir]
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KSFT_PASS	0
+#define KSFT_FAIL	1
+#define KSFT_SKIP	4
+
+#define HWMON_CLASS	"/sys/class/hwmon"
+#define THERMAL_CLASS	"/sys/class/thermal"
+#define HWMON_NAME	"pwmfan"
+#define CDEV_TYPE	"pwm-fan"
+#define ZONE_TYPE	"rpi_acpi_thermal"
+
+enum op {
+	OP_WRITE,
+	OP_READ,
+	OP_TEMP,
+	OP_STATE,
+	OP_COUNT,
+};
+
+static const char * const op_names[OP_COUNT] = {
+	[OP_WRITE] = "pwm1 write",
+	[OP_READ] = "pwm1 read",
+	[OP_TEMP] = "zone temp read",
+	[OP_STATE] = "cur_state write",
+};
+
+struct samples {
+	uint64_t *ns;
+	size_t count;
+	size_t alloc;
+	uint64_t errors;
+};
+
+struct worker {
+	pthread_t thread;
+	unsigned int id;
+	struct samples s[OP_COUNT];
+};
+
+static char pwm_path[1024];
+static char temp_path[1024];
+static char state_path[1024];
+static unsigned long max_state;
+static volatile bool stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void record(struct samples *s, uint64_t ns, bool ok)
+{
+	if (!ok) {
+		s->errors++;
+		return;
+	}
+
+	if (s->count == s->alloc) {
+		s->alloc = s->alloc ? s->alloc * 2 : 4096;
+		s->ns = realloc(s->ns, s->alloc * sizeof(*s->ns));
+		if (!s->ns) {
+			perror("realloc");
+			exit(KSFT_FAIL);
+		}
+	}
+	s->ns[s->count++] = ns;
+}
+
+static bool read_attr(const char *path, char *buf, size_t len)
+{
+	int fd = open(path, O_RDONLY);
+	ssize_t n;
+
+	if (fd < 0)
+		return false;
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n <= 0)
+		return false;
+	buf[n] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+	return true;
+}
+
+static bool write_attr(const char *path, unsigned long val)
+{
+	char buf[32];
+	int fd = open(path, O_WRONLY);
+	int len = snprintf(buf, sizeof(buf), "%lu", val);
+	bool ok;
+
+	if (fd < 0)
+		return false;
+	ok = write(fd, buf, len) == len;
+	close(fd);
+	return ok;
+}
+
+/* One timed pread/pwrite on an open attribute */
+static void timed_op(struct samples *s, int fd, bool write, unsigned long val)
+{
+	char buf[32];
+	uint64_t start;
+	ssize_t n;
+	int len;
+
+	if (write) {
+		len = snprintf(buf, sizeof(buf), "%lu", val);
+		start = now_ns();
+		n = pwrite(fd, buf, len, 0);
+		record(s, now_ns() - start, n == len);
+	} else {
+		start = now_ns();
+		n = pread(fd, buf, sizeof(buf), 0);
+		record(s, now_ns() - start, n > 0);
+	}
+}
+
+static void *writer(void *arg)
+{
+	struct worker *w = arg;
+	unsigned long pwm = w->id * 37;
+	int fd = open(pwm_path, O_WRONLY);
+
+	if (fd < 0)
+		return NULL;
+
+	while (!stop) {
+		timed_op(&w->s[OP_WRITE], fd, true, pwm);
+		pwm = (pwm + 17) % 256;
+	}
+
+	close(fd);
+	return NULL;
+}
+
+static void *reader(void *arg)
+{
+	struct worker *w = arg;
+	int fd = open(pwm_path, O_RDONLY);
+
+	if (fd < 0)
+		return NULL;
+
+	while (!stop)
+		timed_op(&w->s[OP_READ], fd, false, 0);
+
+	close(fd);
+	return NULL;
+}
+
+/* Zone reads go through the sensor cache; state writes through the fan lock */
+static void *thermal(void *arg)
+{
+	struct worker *w = arg;
+	int temp_fd = temp_path[0] ? open(temp_path, O_RDONLY) : -1;
+	int state_fd = state_path[0] ? open(state_path, O_WRONLY) : -1;
+	unsigned long state = max_state ? w->id % (max_state + 1) : 0;
+
+	while (!stop) {
+		if (temp_fd >= 0)
+			timed_op(&w->s[OP_TEMP], temp_fd, false, 0);
+		if (state_fd >= 0) {
+			timed_op(&w->s[OP_STATE], state_fd, true, state);
+			state = max_state ? (state + 1) % (max_state + 1) : 0;
+		}
+		if (temp_fd < 0 && state_fd < 0)
+			break;
+		usleep(1000);
+	}
+
+	if (temp_fd >= 0)
+		close(temp_fd);
+	if (state_fd >= 0)
+		close(state_fd);
+	return NULL;
+}
+
+/* First <class>/<dir>/<attr> reading back as want, into out */
+static bool find_class_dir(const char *class, const char *prefix, const char *attr,
+                           const char *want, char *out, size_t len)
+{
+	struct dirent *de;
+	bool found = false;
+	DIR *d = opendir(class);
+
+	if (!d)
+		return false;
+
+	while (!found && (de = readdir(d))) {
+		char path[1024], buf[64];
+
+		if (strncmp(de->d_name, prefix, strlen(prefix)))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s/%s", class, de->d_name, attr);
+		if (read_attr(path, buf, sizeof(buf)) && !strcmp(buf, want)) {
+			snprintf(out, len, "%s/%s", class, de->d_name);
+			found = true;
+		}
+	}
+
+	closedir(d);
+	return found;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t percentile(const uint64_t *ns, size_t count, unsigned int pct)
+{
+	size_t rank = (count * pct + 99) / 100;
+
+	return ns[rank ? rank - 1 : 0];
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-d seconds] [-w writers] [-r readers] [-t thermal] [-h hwmon dir]\n",
+	        prog);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int duration = 10, writers = 2, readers = 2, thermals = 1;
+	char hwmon[512] = "", dir[512], buf[64], saved_pwm[64] = "", saved_state[64] = "";
+	struct samples total[OP_COUNT] = { };
+	struct worker *w;
+	unsigned int i, n, test = 0;
+	int opt, ret = KSFT_PASS;
+	uint64_t start, elapsed;
+
+	while ((opt = getopt(argc, argv, "d:w:r:t:h:")) != -1) {
+		switch (opt) {
+		case 'd':
+			duration = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			writers = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			readers = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			thermals = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			snprintf(hwmon, sizeof(hwmon), "%s", optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return KSFT_FAIL;
+		}
+	}
+
+	printf("TAP version 13\n");
+
+	if (geteuid()) {
+		printf("1..0 # SKIP needs root\n");
+		return KSFT_SKIP;
+	}
+
+	if (!hwmon[0] && !find_class_dir(HWMON_CLASS, "hwmon", "name", HWMON_NAME,
+	                                 hwmon, sizeof(hwmon))) {
+		printf("1..0 # SKIP no %s hwmon device\n", HWMON_NAME);
+		return KSFT_SKIP;
+	}
+	snprintf(pwm_path, sizeof(pwm_path), "%s/pwm1", hwmon);
+	if (!read_attr(pwm_path, saved_pwm, sizeof(saved_pwm))) {
+		printf("1..0 # SKIP cannot read %s\n", pwm_path);
+		return KSFT_SKIP;
+	}
+
+	/* The thermal side is optional: without it only pwm1 is exercised */
+	if (find_class_dir(THERMAL_CLASS, "thermal_zone", "type", ZONE_TYPE, dir, sizeof(dir)))
+		snprintf(temp_path, sizeof(temp_path), "%s/temp", dir);
+	if (find_class_dir(THERMAL_CLASS, "cooling_device", "type", CDEV_TYPE, dir, sizeof(dir))) {
+		char path[1024];
+
+		snprintf(path, sizeof(path), "%s/max_state", dir);
+		if (read_attr(path, buf, sizeof(buf)))
+			max_state = strtoul(buf, NULL, 0);
+		snprintf(state_path, sizeof(state_path), "%s/cur_state", dir);
+		if (!read_attr(state_path, saved_state, sizeof(saved_state)))
+			state_path[0] = '\0';
+	}
+
+	printf("# %s: %u writers, %u readers, %u thermal for %u s\n",
+	       hwmon, writers, readers, thermals, duration);
+	if (!temp_path[0])
+		printf("# no %s zone, skipping temperature reads\n", ZONE_TYPE);
+	if (!state_path[0])
+		printf("# no %s cooling device, skipping state writes\n", CDEV_TYPE);
+
+	n = writers + readers + thermals;
+	w = calloc(n, sizeof(*w));
+	if (!w) {
+		perror("calloc");
+		return KSFT_FAIL;
+	}
+
+	start = now_ns();
+	for (i = 0; i < n; i++) {
+		void *(*fn)(void *) = i < writers ? writer : i < writers + readers ? reader : thermal;
+
+		w[i].id = i;
+		if (pthread_create(&w[i].thread, NULL, fn, &w[i])) {
+			perror("pthread_create");
+			stop = true;
+			n = i;
+			ret = KSFT_FAIL;
+			break;
+		}
+	}
+
+	if (ret == KSFT_PASS)
+		sleep(duration);
+	stop = true;
+	for (i = 0; i < n; i++)
+		pthread_join(w[i].thread, NULL);
+	elapsed = now_ns() - start;
+
+	/* Restore what the system had, the cooling state last */
+	if (!write_attr(pwm_path, strtoul(saved_pwm, NULL, 0)))
+		printf("# failed to restore %s to %s\n", pwm_path, saved_pwm);
+	if (state_path[0] && !write_attr(state_path, strtoul(saved_state, NULL, 0)))
+		printf("# failed to restore %s to %s\n", state_path, saved_state);
+
+	for (i = 0; i < n; i++) {
+		enum op op;
+
+		for (op = 0; op < OP_COUNT; op++) {
+			struct samples *s = &w[i].s[op];
+
+			if (!s->count && !s->errors)
+				continue;
+			total[op].errors += s->errors;
+			while (s->count)
+				record(&total[op], s->ns[--s->count], true);
+			free(s->ns);
+		}
+	}
+	free(w);
+
+	printf("1..%d\n", OP_COUNT);
+	for (i = 0; i < OP_COUNT; i++) {
+		struct samples *s = &total[i];
+
+		test++;
+		if (!s->count && !s->errors) {
+			printf("ok %u %s # SKIP not exercised\n", test, op_names[i]);
+			continue;
+		}
+
+		qsort(s->ns, s->count, sizeof(*s->ns), cmp_u64);
+		if (s->count)
+			printf("# %s: %zu ops, %.0f/s, p50 %llu us, p99 %llu us, max %llu us, %llu errors\n",
+			       op_names[i], s->count, s->count * 1e9 / elapsed,
+			       (unsigned long long)percentile(s->ns, s->count, 50) / 1000,
+			       (unsigned long long)percentile(s->ns, s->count, 99) / 1000,
+			       (unsigned long long)s->ns[s->count - 1] / 1000,
+			       (unsigned long long)s->errors);
+		if (s->errors) {
+			printf("not ok %u %s # %llu of %llu failed\n", test, op_names[i],
+			       (unsigned long long)s->errors,
+			       (unsigned long long)(s->count + s->errors));
+			ret = KSFT_FAIL;
+		} else {
+			printf("ok %u %s\n", test, op_names[i]);
+		}
+		free(s->ns);
+	}
+
+	return ret;
+}
@@ -0,0 +1,673 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * rpi-thermal-replay - Replay a temperature trace through the RPIT0001
+ * control loop
+ *
+ * Runs the filter, trip bands, adaptive polling, set-point PID and load
+ * feed-forward from rpi-acpi-thermal-ctl.h, the same code rpi-acpi-thermal
+ * builds, against a recorded or synthetic trace. The rest of the loop is
+ * modelled here: the step_wise governor as of v6.6, pwm-fan's state and
+ * floor handling, and rpi-pwm-poe's firmware write suppression on top of a
+ * fake mailbox. Fan power is modelled as max power times the cube of the
+ * firmware duty.
+ *
+ * Trace input, one sample per line, '#' starts a comment:
+ *   <ms> <temp mC> [<cpu load %>]
+ * or the output of the rpi:rpi_thermal_get_temp tracepoint, whose raw
+ * sensor values are used.
+ *
+ * Usage: rpi-thermal-replay [options] [trace | --ramp ...]
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+typedef uint32_t u32;
+typedef int32_t s32;
+typedef uint64_t u64;
+typedef int64_t s64;
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+#define clamp_t(t, v, lo, hi)	((t)(v) < (t)(lo) ? (t)(lo) : (t)(v) > (t)(hi) ? (t)(hi) : (t)(v))
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+
+static inline s64 div_s64(s64 dividend, s32 divisor)
+{
+	return dividend / divisor;
+}
+
+enum thermal_trend {
+	THERMAL_TREND_STABLE,
+	THERMAL_TREND_RAISING,
+	THERMAL_TREND_DROPPING,
+};
+
+#include "rpi-acpi-thermal-ctl.h"
+
+#define MAX_TRIPS		8
+#define MAX_STATES		16
+#define MAX_PWM			255
+#define THERMAL_NO_LIMIT	(~0UL)
+#define THERMAL_NO_TARGET	(~0UL)
+
+#define PWM_PERIOD_NS		80000ULL	/* rpi-pwm-poe RPI_PWM_PERIOD_NS */
+#define POE_DUTY_UNKNOWN	(~0U)
+
+#define RAMP_STEP_MS		100
+
+struct sample {
+	s64 ms;
+	int temp;
+	int load;		/* percent, -1 when the trace has none */
+};
+
+struct trace {
+	struct sample *s;
+	size_t count;
+	size_t alloc;
+};
+
+/* One trip's binding of the fan, as thermal_instance */
+struct instance {
+	unsigned long lower;
+	unsigned long upper;
+	unsigned long target;
+	bool initialized;
+};
+
+/* pwm-fan context over rpi-pwm-poe and a fake mailbox */
+struct fan {
+	unsigned int levels[MAX_STATES];
+	unsigned int max_state;
+	unsigned int state;
+	unsigned int pwm_value;
+	unsigned int floor;
+	bool enabled;
+
+	/* struct pwm_state */
+	u64 duty_cycle;
+	bool pwm_enabled;
+
+	/* rpi-pwm-poe */
+	unsigned int fw_duty;
+
+	u64 state_changes;
+	u64 applies;
+	u64 fw_writes;
+	u64 fw_suppressed;
+};
+
+struct config {
+	s32 trip_temps[MAX_TRIPS];
+	s32 trip_hyst[MAX_TRIPS];
+	int trip_count;
+	u32 min_states[MAX_TRIPS];
+	u32 max_states[MAX_TRIPS];
+	int state_count;
+	unsigned int levels[MAX_STATES];
+	int level_count;
+
+	struct rpi_thermal_filter filter;
+	struct rpi_thermal_poll poll;
+	struct rpi_thermal_pid pid;
+	bool setpoint_mode;
+	u32 pid_period_ms;
+	u32 ff_gain;
+	u32 ff_threshold;
+	unsigned int boot_pwm;
+	unsigned int fan_max_mw;
+};
+
+static void fan_poe_apply(struct fan *fan)
+{
+	unsigned int duty;
+
+	fan->applies++;
+
+	if (!fan->pwm_enabled)
+		duty = 0;
+	else if (fan->duty_cycle < PWM_PERIOD_NS)
+		duty = fan->duty_cycle * MAX_PWM / PWM_PERIOD_NS;
+	else
+		duty = MAX_PWM;
+
+	if (duty == fan->fw_duty) {
+		fan->fw_suppressed++;
+		return;
+	}
+
+	fan->fw_writes++;
+	fan->fw_duty = duty;
+}
+
+/* pwm-fan __set_pwm() */
+static void fan_set_pwm(struct fan *fan, unsigned int pwm)
+{
+	if (pwm > 0) {
+		fan->duty_cycle = DIV_ROUND_UP(pwm * (PWM_PERIOD_NS - 1), MAX_PWM);
+		fan->pwm_enabled = true;
+		fan_poe_apply(fan);
+		fan->enabled = true;
+	} else if (fan->enabled) {
+		fan->pwm_enabled = false;
+		fan->duty_cycle = 0;
+		fan_poe_apply(fan);
+		fan->enabled = false;
+	}
+	fan->pwm_value = pwm;
+}
+
+static void fan_update_state(struct fan *fan, unsigned int pwm)
+{
+	unsigned int i;
+
+	for (i = 0; i < fan->max_state; i++)
+		if (pwm < fan->levels[i + 1])
+			break;
+
+	fan->state = i;
+}
+
+static void fan_set_cur_state(struct fan *fan, unsigned long state)
+{
+	if (state > fan->max_state || state == fan->state)
+		return;
+
+	fan_set_pwm(fan, max(fan->levels[state], fan->floor));
+	fan->state = state;
+	fan->state_changes++;
+}
+
+static void fan_set_floor(struct fan *fan, unsigned int floor)
+{
+	unsigned int pwm = max(floor, fan->levels[fan->state]);
+
+	fan->floor = floor;
+	if (pwm != fan->pwm_value)
+		fan_set_pwm(fan, pwm);
+}
+
+static void fan_set_duty(struct fan *fan, unsigned int pwm)
+{
+	fan_set_pwm(fan, pwm);
+	fan_update_state(fan, pwm);
+}
+
+/* gov_step_wise.c get_target_state() */
+static unsigned long step_wise_target(struct instance *inst, unsigned long cur,
+                                      enum thermal_trend trend, bool throttle)
+{
+	unsigned long next = inst->target;
+
+	if (!inst->initialized) {
+		if (throttle)
+			return clamp_t(unsigned long, cur + 1, inst->lower, inst->upper);
+		return THERMAL_NO_TARGET;
+	}
+
+	if (throttle) {
+		if (trend == THERMAL_TREND_RAISING)
+			next = clamp_t(unsigned long, cur + 1, inst->lower, inst->upper);
+	} else if (trend == THERMAL_TREND_DROPPING) {
+		if (cur <= inst->lower)
+			next = THERMAL_NO_TARGET;
+		else
+			next = clamp_t(unsigned long, cur - 1, inst->lower, inst->upper);
+	}
+
+	return next;
+}
+
+/* __thermal_cdev_update(): the deepest target any trip asks for */
+static void cdev_update(struct fan *fan, struct instance *inst, int count, bool *updated)
+{
+	unsigned long target = 0;
+	int i;
+
+	if (*updated)
+		return;
+
+	for (i = 0; i < count; i++)
+		if (inst[i].target != THERMAL_NO_TARGET && inst[i].target > target)
+			target = inst[i].target;
+
+	fan_set_cur_state(fan, target);
+	*updated = true;
+}
+
+/* step_wise_throttle() for every trip, as __thermal_zone_device_update() */
+static void step_wise(const struct config *cfg, struct fan *fan, struct instance *inst,
+                      int temp, bool *updated)
+{
+	int i;
+
+	for (i = 0; i < cfg->trip_count; i++) {
+		enum thermal_trend trend;
+		unsigned long old;
+		bool throttle;
+
+		trend = rpi_thermal_trip_trend(temp, cfg->trip_temps[i], cfg->trip_hyst[i]);
+		throttle = temp >= cfg->trip_temps[i];
+
+		old = inst[i].target;
+		inst[i].target = step_wise_target(&inst[i], fan->state, trend, throttle);
+		if (!inst[i].initialized || old != inst[i].target) {
+			inst[i].initialized = true;
+			*updated = false;
+		}
+
+		cdev_update(fan, inst, cfg->trip_count, updated);
+	}
+}
+
+static void trace_add(struct trace *t, s64 ms, int temp, int load)
+{
+	if (t->count == t->alloc) {
+		t->alloc = t->alloc ? t->alloc * 2 : 1024;
+		t->s = realloc(t->s, t->alloc * sizeof(*t->s));
+		if (!t->s) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+
+	t->s[t->count++] = (struct sample){ ms, temp, load };
+}
+
+static int trace_read(struct trace *t, FILE *f)
+{
+	char line[512];
+	s64 first = -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		char *ev = strstr(line, "rpi_thermal_get_temp:");
+		long long ms;
+		int temp, load = -1;
+
+		if (ev) {
+			double ts;
+			int zone, raw, ret;
+			char *p = ev;
+
+			/* "... <secs>.<usecs>: rpi_thermal_get_temp: zone=..." */
+			while (p > line && p[-1] == ' ')
+				p--;
+			while (p > line && p[-1] != ' ')
+				p--;
+			if (sscanf(p, "%lf:", &ts) != 1 ||
+			    sscanf(ev, "rpi_thermal_get_temp: zone=%d raw=%d temp=%*d ret=%d",
+			           &zone, &raw, &ret) != 3 || ret)
+				continue;
+			if (first < 0)
+				first = ts * 1000;
+			trace_add(t, (s64)(ts * 1000) - first, raw, -1);
+			continue;
+		}
+
+		if (line[0] == '#' || sscanf(line, "%lld %d %d", &ms, &temp, &load) < 2)
+			continue;
+		if (t->count && ms < t->s[t->count - 1].ms) {
+			fprintf(stderr, "trace goes back in time at %lld ms\n", ms);
+			return -1;
+		}
+		trace_add(t, ms, temp, load);
+	}
+
+	return t->count ? 0 : -1;
+}
+
+/* Piecewise linear from:peak:rise_s:hold_s:fall_s, in mC and seconds */
+static int trace_ramp(struct trace *t, const char *spec)
+{
+	int from, peak, rise, hold, fall;
+	s64 ms, end;
+
+	if (sscanf(spec, "%d:%d:%d:%d:%d", &from, &peak, &rise, &hold, &fall) != 5 ||
+	    rise < 0 || hold < 0 || fall < 0)
+		return -1;
+
+	end = (s64)(rise + hold + fall) * 1000;
+	for (ms = 0; ms <= end; ms += RAMP_STEP_MS) {
+		int temp;
+
+		if (ms < rise * 1000LL)
+			temp = from + (peak - from) * ms / (rise * 1000LL);
+		else if (ms < (rise + hold) * 1000LL)
+			temp = peak;
+		else if (fall)
+			temp = peak - (peak - from) * (ms - (rise + hold) * 1000LL) / (fall * 1000LL);
+		else
+			temp = from;
+		trace_add(t, ms, temp, -1);
+	}
+
+	return 0;
+}
+
+static int parse_list(const char *arg, void *out, int max, bool is_signed)
+{
+	char *end;
+	int n = 0;
+
+	do {
+		unsigned long long v;
+
+		if (n == max)
+			return -1;
+		v = is_signed ? (unsigned long long)strtoll(arg, &end, 0) :
+		                strtoull(arg, &end, 0);
+		if (end == arg)
+			return -1;
+		((u32 *)out)[n++] = v;
+		arg = end + 1;
+	} while (*end == ',');
+
+	return *end ? -1 : n;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] <trace | --ramp from:peak:rise_s:hold_s:fall_s>\n"
+		"  --trips T,..          trip temperatures, mC\n"
+		"  --hyst H,..           trip hysteresis, mC\n"
+		"  --min-states S,..     fan cooling-min-states column\n"
+		"  --max-states S,..     fan cooling-max-states column\n"
+		"  --levels L,..         fan cooling-levels\n"
+		"  --tau MS              filter-time-constant-ms\n"
+		"  --dwell MS            state-dwell-ms\n"
+		"  --poll MIN,MAX        polling-min-ms, polling-max-ms\n"
+		"  --trip-margin MC      polling-trip-margin\n"
+		"  --rise-rate MC_S      polling-rise-rate\n"
+		"  --setpoint MC         control-mode \"setpoint\" at setpoint-temp\n"
+		"  --pid KP,KI,KD        pid-kp, pid-ki, pid-kd\n"
+		"  --pid-period MS       pid-period-ms\n"
+		"  --ff GAIN,THRESHOLD   feedforward-gain, feedforward-threshold\n"
+		"  --boot-pwm PWM        duty UEFI hands over\n"
+		"  --fan-max-power MW    fan power at full duty\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option opts[] = {
+		{ "trips", required_argument, NULL, 't' },
+		{ "hyst", required_argument, NULL, 'y' },
+		{ "min-states", required_argument, NULL, 'm' },
+		{ "max-states", required_argument, NULL, 'M' },
+		{ "levels", required_argument, NULL, 'l' },
+		{ "tau", required_argument, NULL, 'T' },
+		{ "dwell", required_argument, NULL, 'd' },
+		{ "poll", required_argument, NULL, 'p' },
+		{ "trip-margin", required_argument, NULL, 'g' },
+		{ "rise-rate", required_argument, NULL, 'r' },
+		{ "setpoint", required_argument, NULL, 's' },
+		{ "pid", required_argument, NULL, 'k' },
+		{ "pid-period", required_argument, NULL, 'P' },
+		{ "ff", required_argument, NULL, 'f' },
+		{ "boot-pwm", required_argument, NULL, 'b' },
+		{ "fan-max-power", required_argument, NULL, 'w' },
+		{ "ramp", required_argument, NULL, 'R' },
+		{ "help", no_argument, NULL, 'h' },
+		{ }
+	};
+	/* Defaults match PoeDxe and the RPIT0001 driver defaults */
+	struct config cfg = {
+		.trip_temps = { 65000, 70000, 75000, 80000 },
+		.trip_hyst = { 5000, 4999, 4999, 4999 },
+		.trip_count = 4,
+		.min_states = { 1, 2, 3, 4 },
+		.max_states = { 1, 2, 3, 4 },
+		.state_count = 4,
+		.levels = { 0, 64, 128, 192, 255 },
+		.level_count = 5,
+		.poll = { .min_ms = 50, .max_ms = 4000, .trip_margin = 2000, .rise_rate = 500 },
+		.pid = { .setpoint = 70000, .kp = 40000, .ki = 2000, .kd = 0 },
+		.pid_period_ms = 1000,
+		.ff_threshold = 25,
+		.boot_pwm = MAX_PWM,
+		.fan_max_mw = 450,
+	};
+	struct instance inst[MAX_TRIPS];
+	struct trace trace = { };
+	struct fan fan = { .fw_duty = POE_DUTY_UNKNOWN };
+	u64 trip_ms[MAX_TRIPS] = { }, state_ms[MAX_STATES] = { };
+	u64 polls = 0, fast_polls = 0;
+	unsigned int ff_duty = 0, ff_load = 0, pid_duty = MAX_PWM;
+	double energy_uj = 0;
+	s64 now, last_ms = 0, end;
+	int last_temp = 0, max_temp, opt, n;
+	bool updated = true;
+	const char *ramp = NULL;
+	size_t i, cursor = 0;
+	u32 v[3];
+
+	while ((opt = getopt_long(argc, argv, "h", opts, NULL)) != -1) {
+		switch (opt) {
+		case 't':
+			cfg.trip_count = parse_list(optarg, cfg.trip_temps, MAX_TRIPS, true);
+			break;
+		case 'y':
+			n = parse_list(optarg, cfg.trip_hyst, MAX_TRIPS, true);
+			if (n != cfg.trip_count)
+				goto bad;
+			break;
+		case 'm':
+			cfg.state_count = parse_list(optarg, cfg.min_states, MAX_TRIPS, false);
+			break;
+		case 'M':
+			n = parse_list(optarg, cfg.max_states, MAX_TRIPS, false);
+			if (n != cfg.state_count)
+				goto bad;
+			break;
+		case 'l':
+			cfg.level_count = parse_list(optarg, cfg.levels, MAX_STATES, false);
+			break;
+		case 'T':
+			cfg.filter.tau_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			cfg.filter.dwell_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			if (parse_list(optarg, v, 2, false) != 2)
+				goto bad;
+			cfg.poll.min_ms = v[0];
+			cfg.poll.max_ms = v[1];
+			break;
+		case 'g':
+			cfg.poll.trip_margin = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			cfg.poll.rise_rate = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			cfg.setpoint_mode = true;
+			cfg.pid.setpoint = strtol(optarg, NULL, 0);
+			break;
+		case 'k':
+			if (parse_list(optarg, v, 3, false) != 3)
+				goto bad;
+			cfg.pid.kp = v[0];
+			cfg.pid.ki = v[1];
+			cfg.pid.kd = v[2];
+			break;
+		case 'P':
+			cfg.pid_period_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			if (parse_list(optarg, v, 2, false) != 2)
+				goto bad;
+			cfg.ff_gain = min(v[0], MAX_PWM);
+			cfg.ff_threshold = min(v[1], 99);
+			break;
+		case 'b':
+			cfg.boot_pwm = min(strtoul(optarg, NULL, 0), MAX_PWM);
+			break;
+		case 'w':
+			cfg.fan_max_mw = strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			ramp = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	if (cfg.trip_count <= 0 || cfg.state_count != cfg.trip_count ||
+	    cfg.level_count < 2 || !cfg.poll.min_ms || !cfg.pid_period_ms)
+		goto bad;
+	if (cfg.poll.max_ms < cfg.poll.min_ms)
+		cfg.poll.max_ms = cfg.poll.min_ms;
+	cfg.poll.interval_ms = cfg.poll.min_ms;
+
+	if (ramp) {
+		if (trace_ramp(&trace, ramp))
+			goto bad;
+	} else {
+		FILE *f = optind < argc ? fopen(argv[optind], "r") : stdin;
+
+		if (!f) {
+			perror(argv[optind]);
+			return 1;
+		}
+		if (trace_read(&trace, f)) {
+			fprintf(stderr, "no usable samples in trace\n");
+			return 1;
+		}
+		if (f != stdin)
+			fclose(f);
+	}
+
+	/* thermal_zone_bind_cooling_device() limits */
+	memcpy(fan.levels, cfg.levels, sizeof(fan.levels));
+	fan.max_state = cfg.level_count - 1;
+	for (n = 0; n < cfg.trip_count; n++) {
+		inst[n].lower = cfg.min_states[n] == (u32)THERMAL_NO_LIMIT ? 0 : cfg.min_states[n];
+		inst[n].upper = cfg.max_states[n] == (u32)THERMAL_NO_LIMIT ? fan.max_state :
+		                cfg.max_states[n];
+		inst[n].target = THERMAL_NO_TARGET;
+		inst[n].initialized = false;
+		if (inst[n].lower > inst[n].upper || inst[n].upper > fan.max_state) {
+			fprintf(stderr, "trip %d: states %lu..%lu do not fit max state %u\n",
+			        n, inst[n].lower, inst[n].upper, fan.max_state);
+			return 1;
+		}
+	}
+
+	/* Probe: the boot duty is applied once, the state follows it */
+	fan_set_pwm(&fan, cfg.boot_pwm);
+	fan_update_state(&fan, cfg.boot_pwm);
+
+	/* Time above each trip, straight from the trace */
+	max_temp = trace.s[0].temp;
+	for (i = 0; i < trace.count; i++) {
+		s64 len = i + 1 < trace.count ? trace.s[i + 1].ms - trace.s[i].ms : 0;
+
+		max_temp = max(max_temp, trace.s[i].temp);
+		for (n = 0; n < cfg.trip_count; n++)
+			if (trace.s[i].temp >= cfg.trip_temps[n])
+				trip_ms[n] += len;
+	}
+
+	/* Poll work loop, with the sensor holding the last trace sample */
+	end = trace.s[trace.count - 1].ms;
+	for (now = trace.s[0].ms; now <= end; now += cfg.poll.interval_ms) {
+		const struct sample *s;
+		unsigned int interval_ms;
+		bool fast;
+		int temp;
+
+		while (cursor + 1 < trace.count && trace.s[cursor + 1].ms <= now)
+			cursor++;
+		s = &trace.s[cursor];
+
+		/* thermal_zone_device_update(): .get_temp, then the governor */
+		temp = rpi_thermal_filter(&cfg.filter, cfg.trip_temps, cfg.trip_hyst,
+		                          cfg.trip_count, s->temp, now);
+		if (!cfg.setpoint_mode)
+			step_wise(&cfg, &fan, inst, temp, &updated);
+
+		fast = rpi_thermal_poll_fast(&cfg.poll, cfg.trip_temps, cfg.trip_hyst,
+		                             cfg.trip_count, temp, last_temp,
+		                             polls ? now - last_ms : 0);
+
+		if (cfg.ff_gain) {
+			unsigned int duty, old = ff_duty;
+
+			if (s->load >= 0)
+				ff_load = s->load;
+			duty = rpi_thermal_ff_duty(cfg.ff_gain, cfg.ff_threshold, ff_load, MAX_PWM);
+			if (duty != old) {
+				ff_duty = duty;
+				if (!cfg.setpoint_mode)
+					fan_set_floor(&fan, duty);
+				if (duty > old)
+					fast = true;
+			}
+		}
+
+		if (cfg.setpoint_mode) {
+			unsigned int duty;
+
+			duty = rpi_thermal_pid_step(&cfg.pid, temp, polls ? now - last_ms : 0,
+			                            MAX_PWM);
+			duty = max(duty, ff_duty);
+			if (duty != pid_duty) {
+				fan_set_duty(&fan, duty);
+				pid_duty = duty;
+			}
+		}
+
+		last_temp = temp;
+		last_ms = now;
+		polls++;
+		if (fast)
+			fast_polls++;
+		interval_ms = rpi_thermal_poll_next(&cfg.poll, fast,
+		                                    cfg.setpoint_mode ? cfg.pid_period_ms : 0);
+
+		/* The duty holds until the next poll */
+		interval_ms = min((s64)interval_ms, max(end - now, (s64)1));
+		if (fan.fw_duty != POE_DUTY_UNKNOWN) {
+			double d = fan.fw_duty / (double)MAX_PWM;
+
+			energy_uj += cfg.fan_max_mw * d * d * d * interval_ms;
+		}
+		if (fan.state < MAX_STATES)
+			state_ms[fan.state] += interval_ms;
+	}
+
+	printf("duration_ms %lld\n", (long long)(end - trace.s[0].ms));
+	printf("trace_samples %zu\n", trace.count);
+	printf("max_temp %d\n", max_temp);
+	for (n = 0; n < cfg.trip_count; n++)
+		printf("trip%d_above_ms %llu\n", n, (unsigned long long)trip_ms[n]);
+	printf("mode %s\n", cfg.setpoint_mode ? "setpoint" : "trip");
+	printf("polls %llu\n", (unsigned long long)polls);
+	printf("fast_polls %llu\n", (unsigned long long)fast_polls);
+	printf("band_changes %llu\n", (unsigned long long)cfg.filter.band_changes);
+	printf("dwell_suppressed %llu\n", (unsigned long long)cfg.filter.suppressed);
+	printf("state_changes %llu\n", (unsigned long long)fan.state_changes);
+	for (n = 0; n <= (int)fan.max_state && n < MAX_STATES; n++)
+		printf("state%d_ms %llu\n", n, (unsigned long long)state_ms[n]);
+	printf("pwm_applies %llu\n", (unsigned long long)fan.applies);
+	printf("fw_writes %llu\n", (unsigned long long)fan.fw_writes);
+	printf("fw_suppressed %llu\n", (unsigned long long)fan.fw_suppressed);
+	printf("final_duty %u\n", fan.pwm_value);
+	printf("fan_energy_mj %.1f\n", energy_uj / 1000);
+
+	free(trace.s);
+
+	return 0;
+
+bad:
+	usage(argv[0]);
+	return 2;
+}
@@ -1,34 +1,686 @@
 #include <Uefi.h>
 #include <Library/UefiDriverEntryPoint.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/AcpiLib.h>
+#include <Library/DmaLib.h>
+#include <Library/IoLib.h>
+#include <Library/HiiLib.h>
+#include <Library/PcdLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
 
 #include <Library/DxeServicesLib.h>
 #include <Protocol/AcpiTable.h>
+#include <IndustryStandard/Acpi.h>
+#include <IndustryStandard/Bcm2836MBox.h>
+#include <IndustryStandard/RpiMbox.h>
+
+#include "PoeDxe.h"
+
+extern UINT8  PoeDxeHiiBin[];
+extern UINT8  PoeDxeStrings[];
 
 // Replace with your custom GUID (matches ACPI .INF GUID)
 STATIC CONST EFI_GUID mMyAcpiTableGuid = {
   0x3A1F5B7C, 0x9D42, 0x4E8A, { 0xBF, 0x3E, 0x5C, 0x7D, 0x8A, 0x9E, 0x2F, 0x1B }
 };
 
+// PoE HAT registers behind the firmware property interface
+#define POE_MBOX_GET_POE_HAT_VAL    0x00030049
+#define POE_MBOX_SET_POE_HAT_VAL    0x00038049
+#define POE_HAT_REG_PWM             0
+
+#define POE_MBOX_TIMEOUT_US         100000
+#define POE_MBOX_POLL_US            10
+
+#define POE_FAN_PERIOD              EFI_TIMER_PERIOD_SECONDS (2)
+#define POE_FAN_DUTY_UNKNOWN        MAX_UINT32
+
+// _STA of POEH and FAN0, patched through the PHAT name in PoeFan.asl
+#define POE_STA_PRESENT             0x0F
+#define POE_STA_ABSENT              0x00
+
+#define POE_FAN_MAX_DUTY            255
+
+#define AML_STRING_PREFIX           0x0D
+#define AML_DWORD_PREFIX            0x0C
+#define AML_PACKAGE_OP              0x12
+
+STATIC EFI_GUID mPoeFormSetGuid = POE_DXE_FORMSET_GUID;
+
+typedef struct {
+  VENDOR_DEVICE_PATH        VendorDevicePath;
+  EFI_DEVICE_PATH_PROTOCOL  End;
+} HII_VENDOR_DEVICE_PATH;
+
+STATIC HII_VENDOR_DEVICE_PATH mVendorDevicePath = {
+  {
+    {
+      HARDWARE_DEVICE_PATH,
+      HW_VENDOR_DP,
+      {
+        (UINT8)(sizeof (VENDOR_DEVICE_PATH)),
+        (UINT8)((sizeof (VENDOR_DEVICE_PATH)) >> 8)
+      }
+    },
+    POE_DXE_FORMSET_GUID
+  },
+  {
+    END_DEVICE_PATH_TYPE,
+    END_ENTIRE_DEVICE_PATH_SUBTYPE,
+    {
+      (UINT8)(END_DEVICE_PATH_LENGTH),
+      (UINT8)((END_DEVICE_PATH_LENGTH) >> 8)
+    }
+  }
+};
+
+//
+// Built-in thermal tables, used until the setup page has saved a valid
+// PoeFanConfig.
+//
+STATIC CONST POE_FAN_CONFIG mFanConfigDefaults = {
+  { 65000, 70000, 75000, 80000 },
+  {  5000,  4999,  4999,  4999 },
+  { 0, 64, 128, 192, 255 }
+};
+
+// Drives both the boot fan curve and the tables handed to the OS
+STATIC POE_FAN_CONFIG mFanConfig;
+
+#pragma pack(1)
+typedef struct {
+  UINT32  BufferSize;
+  UINT32  Response;
+  UINT32  TagId;
+  UINT32  TagSize;
+  UINT32  TagValueSize;
+  UINT32  Value[3];
+  UINT32  EndTag;
+} POE_MBOX_MSG;
+#pragma pack()
+
+STATIC POE_MBOX_MSG          *mMboxMsg;
+STATIC EFI_PHYSICAL_ADDRESS  mMboxBusAddress;
+STATIC VOID                  *mMboxMapping;
+
+STATIC EFI_EVENT  mFanTimerEvent;
+STATIC EFI_EVENT  mReadyToBootEvent;
+STATIC UINTN      mFanLevel;          // cooling state, 0 is below the first trip
+STATIC UINT32     mFanDuty = POE_FAN_DUTY_UNKNOWN;
+STATIC BOOLEAN    mHatPresent = TRUE;   // assumed unless the probe says otherwise
+
+STATIC
+BOOLEAN
+PoeMboxWaitStatus (
+  IN UINT32  Bit,
+  IN BOOLEAN Set
+  )
+{
+  UINTN  Timeout;
+
+  for (Timeout = POE_MBOX_TIMEOUT_US; Timeout > 0; Timeout -= POE_MBOX_POLL_US) {
+    if (((MmioRead32 (BCM2836_MBOX_BASE_ADDRESS + BCM2836_MBOX_STATUS_OFFSET) & (1U << Bit)) != 0) == Set) {
+      return TRUE;
+    }
+    gBS->Stall (POE_MBOX_POLL_US);
+  }
+
+  return FALSE;
+}
+
+//
+// Post mMboxMsg to the VideoCore channel and poll for the reply.
+//
+STATIC
+EFI_STATUS
+PoeMboxTransaction (
+  VOID
+  )
+{
+  UINT32  Response;
+
+  // Drop any stale replies left in the read FIFO
+  while ((MmioRead32 (BCM2836_MBOX_BASE_ADDRESS + BCM2836_MBOX_STATUS_OFFSET) &
+          (1U << BCM2836_MBOX_STATUS_EMPTY)) == 0) {
+    MmioRead32 (BCM2836_MBOX_BASE_ADDRESS + BCM2836_MBOX_READ_OFFSET);
+  }
+
+  if (!PoeMboxWaitStatus (BCM2836_MBOX_STATUS_FULL, FALSE)) {
+    return EFI_TIMEOUT;
+  }
+
+  MemoryFence ();
+  MmioWrite32 (BCM2836_MBOX_BASE_ADDRESS + BCM2836_MBOX_WRITE_OFFSET,
+               (UINT32)mMboxBusAddress | RPI_MBOX_VC_CHANNEL);
+
+  do {
+    if (!PoeMboxWaitStatus (BCM2836_MBOX_STATUS_EMPTY, FALSE)) {
+      return EFI_TIMEOUT;
+    }
+    Response = MmioRead32 (BCM2836_MBOX_BASE_ADDRESS + BCM2836_MBOX_READ_OFFSET);
+  } while ((Response & 0xF) != RPI_MBOX_VC_CHANNEL);
+
+  MemoryFence ();
+  if (mMboxMsg->Response != RPI_MBOX_RESP_SUCCESS ||
+      (mMboxMsg->TagValueSize & BIT31) == 0) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+//
+// Single-tag property transaction on the VideoCore channel. Raised to
+// TPL_CALLBACK, the level RpiFirmwareDxe holds while it owns the mailbox,
+// so the two never interleave.
+//
+STATIC
+EFI_STATUS
+PoeMboxProperty (
+  IN     UINT32  Tag,
+  IN OUT UINT32  *Value,
+  IN     UINTN   Count
+  )
+{
+  EFI_TPL     OldTpl;
+  EFI_STATUS  Status;
+
+  if (mMboxMsg == NULL || Count > ARRAY_SIZE (mMboxMsg->Value)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  ZeroMem (mMboxMsg, sizeof (*mMboxMsg));
+  mMboxMsg->BufferSize = sizeof (*mMboxMsg);
+  mMboxMsg->TagId = Tag;
+  mMboxMsg->TagSize = sizeof (mMboxMsg->Value);
+  CopyMem (mMboxMsg->Value, Value, Count * sizeof (UINT32));
+
+  Status = PoeMboxTransaction ();
+  if (!EFI_ERROR (Status)) {
+    CopyMem (Value, mMboxMsg->Value, Count * sizeof (UINT32));
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+PoeMboxInit (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Size;
+
+  Status = DmaAllocateBuffer (EfiBootServicesData, EFI_SIZE_TO_PAGES (sizeof (*mMboxMsg)),
+                              (VOID **)&mMboxMsg);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Size = EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES (sizeof (*mMboxMsg)));
+  Status = DmaMap (MapOperationBusMasterCommonBuffer, mMboxMsg, &Size,
+                   &mMboxBusAddress, &mMboxMapping);
+  if (EFI_ERROR (Status)) {
+    DmaFreeBuffer (EFI_SIZE_TO_PAGES (sizeof (*mMboxMsg)), mMboxMsg);
+    mMboxMsg = NULL;
+  }
+
+  return Status;
+}
+
+STATIC
+VOID
+PoeMboxExit (
+  VOID
+  )
+{
+  if (mMboxMsg == NULL) {
+    return;
+  }
+
+  DmaUnmap (mMboxMapping);
+  DmaFreeBuffer (EFI_SIZE_TO_PAGES (sizeof (*mMboxMsg)), mMboxMsg);
+  mMboxMsg = NULL;
+}
+
+STATIC
+EFI_STATUS
+PoeGetTemperature (
+  OUT UINT32  *Temp
+  )
+{
+  UINT32      Value[2] = { 0, 0 };   // sensor id, mC
+  EFI_STATUS  Status;
+
+  Status = PoeMboxProperty (RPI_MBOX_GET_TEMPERATURE, Value, ARRAY_SIZE (Value));
+  if (!EFI_ERROR (Status)) {
+    *Temp = Value[1];
+  }
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+PoeSetFanDuty (
+  IN UINT32  Duty
+  )
+{
+  UINT32      Value[3] = { POE_HAT_REG_PWM, Duty, 0 };   // reg, value, status
+  EFI_STATUS  Status;
+
+  Status = PoeMboxProperty (POE_MBOX_SET_POE_HAT_VAL, Value, ARRAY_SIZE (Value));
+  if (!EFI_ERROR (Status) && Value[2] != 0) {
+    Status = EFI_DEVICE_ERROR;
+  }
+
+  return Status;
+}
+
+//
+// The firmware answers GET_POE_HAT_VAL with a non-zero status when there is
+// no HAT on the I2C bus. Only a definite "not there" clears mHatPresent; if
+// the mailbox itself fails the devices are left enabled as before.
+//
+STATIC
+VOID
+PoeHatProbe (
+  VOID
+  )
+{
+  UINT32      Value[3] = { POE_HAT_REG_PWM, 0, 0 };   // reg, value, status
+  EFI_STATUS  Status;
+
+  Status = PoeMboxProperty (POE_MBOX_GET_POE_HAT_VAL, Value, ARRAY_SIZE (Value));
+  if (EFI_ERROR (Status)) {
+    DEBUG((DEBUG_WARN, "PoE HAT probe failed: %r\n", Status));
+    return;
+  }
+
+  mHatPresent = Value[2] == 0;
+  DEBUG((DEBUG_INFO, "PoE HAT %a\n", mHatPresent ? "present" : "not present"));
+}
+
+//
+// Step up as soon as a trip is reached, and step down one trip at a time,
+// each only once the temperature has dropped below it by its hysteresis.
+// This matches rpi_thermal_band() in the kernel driver.
+//
+STATIC
+UINTN
+PoeFanLevel (
+  IN UINT32  Temp
+  )
+{
+  UINTN  Level;
+
+  Level = mFanLevel;
+  while (Level < POE_FAN_TRIPS && Temp >= mFanConfig.TripTemp[Level]) {
+    Level++;
+  }
+
+  while (Level > 0 &&
+         Temp + mFanConfig.TripHyst[Level - 1] <= mFanConfig.TripTemp[Level - 1]) {
+    Level--;
+  }
+
+  return Level;
+}
+
+STATIC
+VOID
+PoeFanUpdate (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Temp;
+  UINTN       Level;
+  UINT32      Duty;
+
+  Status = PoeGetTemperature (&Temp);
+  if (EFI_ERROR (Status)) {
+    DEBUG((DEBUG_WARN, "PoE fan: failed to read temperature: %r\n", Status));
+    return;
+  }
+
+  Level = PoeFanLevel (Temp);
+  Duty = mFanConfig.Level[Level];
+  if (Duty == mFanDuty) {
+    return;
+  }
+
+  Status = PoeSetFanDuty (Duty);
+  if (EFI_ERROR (Status)) {
+    DEBUG((DEBUG_WARN, "PoE fan: failed to set duty %u: %r\n", Duty, Status));
+    mFanDuty = POE_FAN_DUTY_UNKNOWN;
+    return;
+  }
+
+  DEBUG((DEBUG_INFO, "PoE fan: %u mC, duty %u\n", Temp, Duty));
+  mFanLevel = Level;
+  mFanDuty = Duty;
+}
+
+STATIC
+VOID
+EFIAPI
+PoeFanTimer (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  PoeFanUpdate ();
+}
+
+STATIC
+BOOLEAN
+PoeConfigValid (
+  IN CONST POE_FAN_CONFIG  *Config
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < POE_FAN_TRIPS; Index++) {
+    if (Config->TripHyst[Index] >= Config->TripTemp[Index] ||
+        (Index > 0 && Config->TripTemp[Index] <= Config->TripTemp[Index - 1])) {
+      return FALSE;
+    }
+  }
+
+  for (Index = 0; Index <= POE_FAN_TRIPS; Index++) {
+    if (Config->Level[Index] > POE_FAN_MAX_DUTY ||
+        (Index > 0 && Config->Level[Index] < Config->Level[Index - 1])) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+//
+// Load the thermal tables from the PoeFanConfig variable. The first boot
+// creates it from the defaults so the setup page has something to edit;
+// an invalid variable is left for the user to fix and the defaults are used.
+//
+STATIC
+VOID
+PoeLoadConfig (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Size;
+
+  Size = sizeof (mFanConfig);
+  Status = gRT->GetVariable (POE_FAN_CONFIG_VARIABLE, &mPoeFormSetGuid, NULL,
+                             &Size, &mFanConfig);
+  if (!EFI_ERROR (Status) && Size == sizeof (mFanConfig) && PoeConfigValid (&mFanConfig)) {
+    return;
+  }
+
+  CopyMem (&mFanConfig, &mFanConfigDefaults, sizeof (mFanConfig));
+
+  //
+  // Never store tables the next boot would reject
+  //
+  if (!PoeConfigValid (&mFanConfig)) {
+    DEBUG((DEBUG_ERROR, "PoE: built-in fan tables are invalid, not creating %s\n",
+           POE_FAN_CONFIG_VARIABLE));
+  } else if (Status == EFI_NOT_FOUND) {
+    Status = gRT->SetVariable (POE_FAN_CONFIG_VARIABLE, &mPoeFormSetGuid,
+                               EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                               sizeof (mFanConfig), &mFanConfig);
+    if (EFI_ERROR (Status)) {
+      DEBUG((DEBUG_WARN, "PoE: failed to create %s: %r\n", POE_FAN_CONFIG_VARIABLE, Status));
+    }
+  } else {
+    DEBUG((DEBUG_WARN, "PoE: invalid %s, using defaults\n", POE_FAN_CONFIG_VARIABLE));
+  }
+}
+
+STATIC
 EFI_STATUS
+PoeInstallHiiPages (
+  VOID
+  )
+{
+  EFI_HII_HANDLE  HiiHandle;
+  EFI_HANDLE      DriverHandle;
+  EFI_STATUS      Status;
+
+  DriverHandle = NULL;
+  Status = gBS->InstallMultipleProtocolInterfaces (&DriverHandle,
+                  &gEfiDevicePathProtocolGuid,
+                  &mVendorDevicePath,
+                  NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  HiiHandle = HiiAddPackages (&mPoeFormSetGuid, DriverHandle, PoeDxeStrings,
+                              PoeDxeHiiBin, NULL);
+  if (HiiHandle == NULL) {
+    gBS->UninstallMultipleProtocolInterfaces (DriverHandle,
+           &gEfiDevicePathProtocolGuid,
+           &mVendorDevicePath,
+           NULL);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  return EFI_SUCCESS;
+}
+
+//
+// Patch a placeholder _DSD property, either a single integer or a package
+// of Count integers. Every value must be DWord encoded in the AML (e.g.
+// 0xFFFFFFFF) so it can be rewritten in place; the ACPI table protocol
+// recomputes the checksum on install.
+//
+STATIC
+BOOLEAN
+PoePatchDsdProperty (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN     CONST CHAR8                  *Name,
+  IN     CONST UINT32                 *Values,
+  IN     UINTN                        Count
+  )
+{
+  UINT8  *Aml;
+  UINT8  *End;
+  UINTN  Len;
+  UINTN  Index;
+
+  Len = AsciiStrLen (Name);
+  Aml = (UINT8 *)(Table + 1);
+  End = (UINT8 *)Table + Table->Length;
+
+  for ( ; Aml + Len + 2 < End; Aml++) {
+    if (Aml[0] != AML_STRING_PREFIX ||
+        CompareMem (Aml + 1, Name, Len) != 0 ||
+        Aml[Len + 1] != 0) {
+      continue;
+    }
+
+    Aml += Len + 2;
+    if (*Aml == AML_PACKAGE_OP && Aml + 2 < End) {
+      // PkgLength lead byte: bits 7-6 count the bytes that follow it
+      Aml += 2 + (Aml[1] >> 6);
+      if (Aml >= End || *Aml++ != Count) {
+        break;
+      }
+    } else if (Count != 1) {
+      break;
+    }
+
+    if (Aml + Count * 5 > End) {
+      break;
+    }
+    for (Index = 0; Index < Count; Index++) {
+      if (Aml[Index * 5] != AML_DWORD_PREFIX) {
+        DEBUG((DEBUG_WARN, "PoE: _DSD property %a is not a placeholder\n", Name));
+        return FALSE;
+      }
+    }
+    for (Index = 0; Index < Count; Index++) {
+      WriteUnaligned32 ((UINT32 *)(Aml + Index * 5 + 1), Values[Index]);
+    }
+    return TRUE;
+  }
+
+  DEBUG((DEBUG_WARN, "PoE: _DSD property %a not found\n", Name));
+  return FALSE;
+}
+
+STATIC
+BOOLEAN
 EFIAPI
-PoeDxeEntryPoint (
-  IN EFI_HANDLE        ImageHandle,
-  IN EFI_SYSTEM_TABLE  *SystemTable
+PoeAcpiTableCheck (
+  IN EFI_ACPI_DESCRIPTION_HEADER  *AcpiHeader
+  )
+{
+  EFI_STATUS  Status;
+
+  // Unpatched trips would be garbage to the OS, so skip the table instead
+  if (!PoePatchDsdProperty (AcpiHeader, "active-trip-temps", mFanConfig.TripTemp, POE_FAN_TRIPS) ||
+      !PoePatchDsdProperty (AcpiHeader, "active-trip-hysteresis", mFanConfig.TripHyst, POE_FAN_TRIPS) ||
+      !PoePatchDsdProperty (AcpiHeader, "cooling-levels", mFanConfig.Level, POE_FAN_TRIPS + 1)) {
+    DEBUG((DEBUG_ERROR, "PoE: thermal tables do not match PoeFan.asl, not installing\n"));
+    return FALSE;
+  }
+
+  PoePatchDsdProperty (AcpiHeader, "boot-pwm", &mFanDuty, 1);
+
+  // RPEC is the SoC sensor and stays; POEH and FAN0 follow the HAT
+  Status = AcpiUpdateSdtNameInteger (AcpiHeader, "PHAT",
+                                     mHatPresent ? POE_STA_PRESENT : POE_STA_ABSENT);
+  if (EFI_ERROR (Status)) {
+    DEBUG((DEBUG_WARN, "PoE: failed to patch PHAT: %r\n", Status));
+  }
+
+  return TRUE;
+}
+
+//
+// Hand over to the OS: stop driving the fan and publish the last duty in
+// FAN0 so the kernel driver starts from it.
+//
+STATIC
+VOID
+PoeHandOver (
+  VOID
   )
 {
   EFI_STATUS Status;
 
+  if (mFanTimerEvent != NULL) {
+    gBS->CloseEvent (mFanTimerEvent);
+    mFanTimerEvent = NULL;
+    PoeFanUpdate ();
+  }
+  PoeMboxExit ();
+
   DEBUG((DEBUG_INFO, "Installing ACPI table from FV using GUID...\n"));
 
-  Status = LocateAndInstallAcpiFromFvConditional(&mMyAcpiTableGuid, NULL);
+  Status = LocateAndInstallAcpiFromFvConditional(&mMyAcpiTableGuid, PoeAcpiTableCheck);
   if (EFI_ERROR(Status)) {
     DEBUG((DEBUG_ERROR, "Failed to install ACPI table: %r\n", Status));
   } else {
-    DEBUG((DEBUG_INFO, "ACPI table installed successfully\n"));
+    DEBUG((DEBUG_INFO, "ACPI table installed successfully, boot duty %u\n", mFanDuty));
+  }
+}
+
+STATIC
+VOID
+EFIAPI
+PoeReadyToBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  gBS->CloseEvent (Event);
+  PoeHandOver ();
+}
+
+STATIC
+EFI_STATUS
+PoeFanStart (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+
+  Status = PoeMboxInit ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  PoeHatProbe ();
+  if (!mHatPresent) {
+    PoeMboxExit ();
+    return EFI_NOT_FOUND;
+  }
+
+  PoeFanUpdate ();
+
+  Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+                             PoeFanTimer, NULL, &mFanTimerEvent);
+  if (EFI_ERROR (Status)) {
+    mFanTimerEvent = NULL;
+    PoeMboxExit ();
+    return Status;
+  }
+
+  Status = gBS->SetTimer (mFanTimerEvent, TimerPeriodic, POE_FAN_PERIOD);
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (mFanTimerEvent);
+    mFanTimerEvent = NULL;
+    PoeMboxExit ();
   }
 
   return Status;
 }
+
+EFI_STATUS
+EFIAPI
+PoeDxeEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS Status;
+
+  PoeLoadConfig ();
+
+  Status = PoeInstallHiiPages ();
+  if (EFI_ERROR(Status)) {
+    DEBUG((DEBUG_WARN, "Failed to install PoE setup page: %r\n", Status));
+  }
+
+  // Boot fan control is best effort; the table is installed regardless
+  Status = PoeFanStart ();
+  if (EFI_ERROR(Status)) {
+    DEBUG((DEBUG_WARN, "PoE fan control unavailable: %r\n", Status));
+  }
+
+  //
+  // Without ReadyToBoot, hand over now rather than unloading: the OS still
+  // gets its table, only the boot fan curve stops early.
+  //
+  Status = EfiCreateEventReadyToBootEx (TPL_CALLBACK, PoeReadyToBoot, NULL,
+                                        &mReadyToBootEvent);
+  if (EFI_ERROR(Status)) {
+    DEBUG((DEBUG_ERROR, "Failed to register ReadyToBoot: %r, installing now\n", Status));
+    PoeHandOver ();
+  }
+
+  return EFI_SUCCESS;
+}
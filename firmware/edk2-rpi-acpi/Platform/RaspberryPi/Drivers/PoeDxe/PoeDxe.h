@@ -0,0 +1,23 @@
+#ifndef POE_DXE_H_
+#define POE_DXE_H_
+
+// Setup page and the "PoeFanConfig" variable backing it
+#define POE_DXE_FORMSET_GUID \
+  { 0x0e3e1c22, 0x24bc, 0x4c9c, { 0x82, 0xbd, 0x87, 0x26, 0x0c, 0xe3, 0x47, 0x61 } }
+
+#define POE_FAN_CONFIG_VARIABLE   L"PoeFanConfig"
+
+#define POE_FAN_TRIPS             4
+
+//
+// Thermal tables patched into the RPEC and FAN0 _DSD packages. Temperatures
+// are in mC; a cooling level is the fan duty (0-255) at each state, state 0
+// being below the first trip.
+//
+typedef struct {
+  UINT32  TripTemp[POE_FAN_TRIPS];
+  UINT32  TripHyst[POE_FAN_TRIPS];
+  UINT32  Level[POE_FAN_TRIPS + 1];
+} POE_FAN_CONFIG;
+
+#endif // POE_DXE_H_